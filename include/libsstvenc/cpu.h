@@ -0,0 +1,76 @@
+#ifndef _SSTVENC_CPU_H
+#define _SSTVENC_CPU_H
+
+/*!
+ * @defgroup cpu CPU feature detection
+ * @{
+ *
+ * Run-time detection of the SIMD instruction set extensions available on the
+ * host CPU.  The vectorised kernels in @ref vecmath and @ref sampfmt are
+ * selected from the features reported here, so a single build of the library
+ * can make use of whatever the machine it runs on supports.
+ *
+ * Detection happens once, the first time the features are queried.  The set
+ * of features actually used can be narrowed with
+ * @ref sstvenc_cpu_set_features, e.g. to compare SIMD kernels against the
+ * scalar fallback.
+ */
+
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdint.h>
+
+/*!
+ * @defgroup cpu_features CPU feature flags
+ * @{
+ */
+
+/*! x86-64 SSE2, always present on x86-64 CPUs. */
+#define SSTVENC_CPU_FEAT_SSE2 (1 << 0)
+/*! x86-64 AVX2. */
+#define SSTVENC_CPU_FEAT_AVX2 (1 << 1)
+/*!
+ * ARM NEON (Advanced SIMD).  Always present on arm64.  On 32-bit ARM this
+ * is reported if the kernel says the CPU has it, but NEON there has no
+ * double-precision support so no kernels make use of it yet.
+ */
+#define SSTVENC_CPU_FEAT_NEON (1 << 2)
+/*! All features. */
+#define SSTVENC_CPU_FEAT_ALL  (0xffffffff)
+
+/*! @} */
+
+/*!
+ * Return the SIMD features supported by the host CPU, regardless of any
+ * restriction set with @ref sstvenc_cpu_set_features.
+ *
+ * @returns	Bit-mask of @ref cpu_features.
+ */
+uint32_t sstvenc_cpu_detect(void);
+
+/*!
+ * Return the SIMD features the library will make use of.
+ *
+ * @returns	Bit-mask of @ref cpu_features.
+ */
+uint32_t sstvenc_cpu_get_features(void);
+
+/*!
+ * Restrict the SIMD features the library will make use of.  Features not
+ * supported by the host CPU are ignored.  This is not thread-safe with
+ * respect to rendering, so should be called before any samples are
+ * generated.
+ *
+ * @param[in]	features	Bit-mask of @ref cpu_features that may be
+ * 				used.  Pass @ref SSTVENC_CPU_FEAT_ALL to
+ * 				undo a previous restriction or 0 to force
+ * 				the scalar fallback.
+ */
+void	 sstvenc_cpu_set_features(uint32_t features);
+
+/*! @} */
+
+#endif
@@ -20,7 +20,8 @@
  *	200,				// dit period
  *	5,				// rising/falling slope period
  *	48000,				// sample rate in Hz
- *	SSTVENC_TS_UNIT_MILLISECONDS	// time unit
+ *	SSTVENC_TS_UNIT_MILLISECONDS,	// time unit
+ *	SSTVENC_OSC_KERNEL_LIBM		// oscillator sine kernel
  * );
  *
  * while(cw.state != SSTVENC_CW_MOD_STATE_DONE) {
@@ -162,11 +163,13 @@ struct sstvenc_cw_mod {
  * 					in hertz.
  * @param[in]		time_unit	The time unit used for measuring
  * 					@a dit_period and @a slope_period.
+ * @param[in]		kernel		Oscillator sine kernel, one of
+ * 					@ref oscillator_kernels.
  */
 void   sstvenc_cw_init(struct sstvenc_cw_mod* const cw, const char* text,
 		       double amplitude, double frequency, double dit_period,
 		       double slope_period, uint32_t sample_rate,
-		       uint8_t time_unit);
+		       uint8_t time_unit, uint8_t kernel);
 
 /*!
  * Compute the next sample in the state machine.  The state machine will be
@@ -188,5 +191,36 @@ void   sstvenc_cw_compute(struct sstvenc_cw_mod* const cw);
 size_t sstvenc_cw_fill_buffer(struct sstvenc_cw_mod* const cw, double* buffer,
 			      size_t buffer_sz);
 
+/*!
+ * Fill the given buffer with single-precision audio samples from the CW
+ * modulator.  The samples are computed in double precision and narrowed, see
+ * @ref sampfmt.  Otherwise identical to @ref sstvenc_cw_fill_buffer.
+ *
+ * @param[inout]	cw		CW state machine to pull samples from.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the audio buffer in samples.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t sstvenc_cw_fill_buffer_f32(struct sstvenc_cw_mod* const cw,
+				  float* buffer, size_t buffer_sz);
+
+/*!
+ * Fill the given buffer with signed 16-bit linear PCM samples from the CW
+ * modulator.  The samples are computed in double precision, then scaled,
+ * clipped and byte-swapped as described for @ref sstvenc_sampfmt_f64_to_s16.
+ * Otherwise identical to @ref sstvenc_cw_fill_buffer.
+ *
+ * @param[inout]	cw		CW state machine to pull samples from.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the audio buffer in samples.
+ * @param[in]		endianness	Byte order of the samples, see
+ * 					@ref sampfmt_endian.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t sstvenc_cw_fill_s16(struct sstvenc_cw_mod* const cw, int16_t* buffer,
+			   size_t buffer_sz, uint8_t endianness);
+
 /*! @} */
 #endif
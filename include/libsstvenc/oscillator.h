@@ -11,6 +11,12 @@
  * The phase is computed at each sample step, and increments modulo 2-Pi.
  * Frequency, amplitude and phase can be modified at any time, they take
  * effect on the next call to @ref sstvenc_osc_compute.
+ *
+ * The sine function itself is computed by one of several kernels, chosen
+ * when the oscillator is initialised (see @ref oscillator_kernels).  These
+ * trade spectral purity for speed; the error bounds quoted are the maximum
+ * absolute error of the output relative to a full-scale (amplitude 1.0)
+ * sinusoid.
  */
 
 /*
@@ -18,8 +24,61 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <stddef.h>
 #include <stdint.h>
 
+/*!
+ * @defgroup oscillator_kernels Oscillator sine kernels
+ * @{
+ */
+
+/*!
+ * C library `sin()`.  This is the reference implementation: accurate to
+ * within an ULP or so, but the slowest on most platforms.
+ */
+#define SSTVENC_OSC_KERNEL_LIBM	    (0)
+
+/*!
+ * Linearly-interpolated sine look-up table, indexed directly from the
+ * fixed-point phase (512 entries per radian, ~25kB shared between all
+ * oscillators).  Maximum error is 4.8×10⁻⁷ (about -126dBFS).
+ */
+#define SSTVENC_OSC_KERNEL_LUT	    (1)
+
+/*!
+ * Complex phasor recursion.  The phasor is rotated by the phase increment
+ * each sample using a complex multiply, renormalised every sample, and
+ * re-synchronised to the fixed-point phase every
+ * @ref SSTVENC_OSC_PHASOR_RESYNC samples and whenever the frequency changes.
+ * Maximum error against an ideal sinusoid is 10⁻¹².  The fixed-point phase
+ * used by the other kernels loses 2.4×10⁻¹⁰ radians each time it wraps, so
+ * between re-synchronisations this kernel may drift from them by up to 10⁻⁷
+ * at high frequencies.
+ *
+ * This is the fastest kernel for long steady tones, but each frequency change
+ * costs a `sin()`/`cos()` pair, so it is a poor choice for the per-pixel
+ * frequency changes of SSTV image data.  Changes written directly to
+ * sstvenc_oscillator#offset or sstvenc_oscillator#phase take effect at the
+ * next re-synchronisation.
+ */
+#define SSTVENC_OSC_KERNEL_PHASOR   (2)
+
+/*!
+ * Degree-13 odd minimax polynomial evaluated over a quarter-wave.  Maximum
+ * error is 4×10⁻¹⁴.  The polynomial is evaluated by the SIMD kernels in
+ * @ref vecmath, so this is the kernel that benefits most from
+ * @ref sstvenc_osc_fill.
+ */
+#define SSTVENC_OSC_KERNEL_POLY	    (3)
+
+/*!
+ * Number of samples between phasor re-synchronisations when using
+ * @ref SSTVENC_OSC_KERNEL_PHASOR.
+ */
+#define SSTVENC_OSC_PHASOR_RESYNC   (1024)
+
+/*! @} */
+
 /*!
  * Oscillator data structure.  This must remain allocated for the lifetime of
  * the sinusoid.
@@ -48,6 +107,16 @@ struct sstvenc_oscillator {
 	 * be read from this field.
 	 */
 	double	 output;
+	/*!
+	 * Current phasor (cosine, sine) for @ref SSTVENC_OSC_KERNEL_PHASOR.
+	 * Not used by other kernels.
+	 */
+	double	 phasor[2];
+	/*!
+	 * Per-sample phasor rotation (cosine, sine) for
+	 * @ref SSTVENC_OSC_KERNEL_PHASOR.  Not used by other kernels.
+	 */
+	double	 rotation[2];
 	/*!
 	 * Sample rate for the sinusoid in Hz.  Must not be changed after
 	 * initialisation.
@@ -67,6 +136,17 @@ struct sstvenc_oscillator {
 	 * Hz.
 	 */
 	uint32_t phase_inc;
+	/*!
+	 * Number of samples remaining before the phasor is re-synchronised
+	 * with sstvenc_oscillator#phase.  Only used by
+	 * @ref SSTVENC_OSC_KERNEL_PHASOR.
+	 */
+	uint16_t phasor_left;
+	/*!
+	 * The sine kernel in use, one of @ref oscillator_kernels.  Use
+	 * @ref sstvenc_osc_set_kernel to change this.
+	 */
+	uint8_t	 kernel;
 };
 
 /*!
@@ -88,6 +168,17 @@ double sstvenc_osc_get_frequency(const struct sstvenc_oscillator* const osc);
 void   sstvenc_osc_set_frequency(struct sstvenc_oscillator* const osc,
 				 double				  frequency);
 
+/*!
+ * Select the sine kernel used by the oscillator.  The change takes effect on
+ * the next call to @ref sstvenc_osc_compute and does not disturb the phase.
+ *
+ * @param[inout]	osc		Oscillator context being updated.
+ * @param[in]		kernel		The new kernel, one of
+ * 					@ref oscillator_kernels.
+ */
+void   sstvenc_osc_set_kernel(struct sstvenc_oscillator* const osc,
+			      uint8_t				 kernel);
+
 /*!
  * Initialise an oscillator with the given amplitude, frequency and phase
  * offset.  Use this when starting a new sinusoid.
@@ -103,9 +194,13 @@ void   sstvenc_osc_set_frequency(struct sstvenc_oscillator* const osc,
  * @param[in]		offset		Starting phase offset in radians.
  *
  * @param[in]		sample_rate	Output sample rate in hertz.
+ *
+ * @param[in]		kernel		Sine kernel to use, one of
+ * 					@ref oscillator_kernels.
  */
 void sstvenc_osc_init(struct sstvenc_oscillator* const osc, double amplitude,
-		      double frequency, double offset, uint32_t sample_rate);
+		      double frequency, double offset, uint32_t sample_rate,
+		      uint8_t kernel);
 
 /*!
  * Compute the next sinusoid value and store it in the output field.
@@ -117,6 +212,80 @@ void sstvenc_osc_init(struct sstvenc_oscillator* const osc, double amplitude,
  */
 void sstvenc_osc_compute(struct sstvenc_oscillator* const osc);
 
+/*!
+ * Render a block of samples at the current amplitude and frequency.  This is
+ * equivalent to calling @ref sstvenc_osc_compute @a buffer_sz times and
+ * collecting sstvenc_oscillator#output after each call, but is considerably
+ * faster for long runs of constant tone.  A no-op if the sample rate is set
+ * to zero.
+ *
+ * On return, sstvenc_oscillator#output holds the last sample written.
+ *
+ * @param[inout]	osc		Oscillator context being computed.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Number of samples to write.
+ */
+void sstvenc_osc_fill(struct sstvenc_oscillator* const osc, double* buffer,
+		      size_t buffer_sz);
+
+/*!
+ * Render a block of samples at the current frequency, taking the amplitude
+ * of each sample from an envelope.  This is equivalent to setting
+ * sstvenc_oscillator#amplitude to each envelope value in turn then calling
+ * @ref sstvenc_osc_compute.  A no-op if the sample rate is set to zero.
+ *
+ * On return, sstvenc_oscillator#output holds the last sample written and
+ * sstvenc_oscillator#amplitude the last envelope value used.
+ *
+ * @param[inout]	osc		Oscillator context being computed.
+ * @param[in]		envelope	Amplitude of each sample, at least
+ * 					@a buffer_sz values.
+ * @param[out]		buffer		Audio buffer to write samples to.  May
+ * 					be the same as @a envelope.
+ * @param[in]		buffer_sz	Number of samples to write.
+ */
+void sstvenc_osc_fill_env(struct sstvenc_oscillator* const osc,
+			  const double* envelope, double* buffer,
+			  size_t buffer_sz);
+
+/*!
+ * Compute the fixed-point phase increment for the given frequency.  This
+ * can be used to pre-compute increments for frequencies that are used
+ * often, and applied with @ref sstvenc_osc_set_phase_inc.
+ *
+ * @param[in]		sample_rate	Sample rate in Hz.
+ * @param[in]		frequency	The frequency in Hertz.  The same
+ * 					limits apply as for
+ * 					@ref sstvenc_osc_set_frequency.
+ *
+ * @returns		Phase increment for sstvenc_oscillator#phase_inc.
+ */
+uint32_t sstvenc_osc_freq_phase_inc(uint32_t sample_rate, double frequency);
+
+/*!
+ * Set the oscillator frequency as a fixed-point phase increment.
+ *
+ * @param[inout]	osc		Oscillator context being updated.
+ * @param[in]		phase_inc	Phase increment, as computed by
+ * 					@ref sstvenc_osc_freq_phase_inc.
+ */
+void sstvenc_osc_set_phase_inc(struct sstvenc_oscillator* const osc,
+			       uint32_t				phase_inc);
+
+/*!
+ * Advance the oscillator by the given number of samples without computing
+ * them.  sstvenc_oscillator#output is left unchanged.  The phase afterwards
+ * is exactly what it would be had the samples been computed, however
+ * @ref SSTVENC_OSC_KERNEL_PHASOR re-synchronises its phasor on the next
+ * sample, so it may differ from a continuous run by the phasor's rounding
+ * error.
+ *
+ * @param[inout]	osc		Oscillator context being updated.
+ * @param[in]		samples		Number of samples to skip.
+ */
+void sstvenc_osc_skip(struct sstvenc_oscillator* const osc,
+		      uint64_t			       samples);
+
 /*! @} */
 
 #endif
@@ -32,7 +32,7 @@ struct sstvenc_oscillator;
  * immediately moves the state machine to SSTVENC_PS_PHASE_RISE and handles
  * the machine accordingly.
  */
-#define SSTVENC_PS_PHASE_INIT	 (0)
+#define SSTVENC_PS_PHASE_INIT	  (0)
 
 /*!
  * Rising slope.  The amplitude is being ramped up to maximum.
@@ -41,7 +41,7 @@ struct sstvenc_oscillator;
  * it reaches or exceeds sstvenc_pulseshape#rise_sz, the state machine resets
  * the counter and advances to SSTVENC_PS_PHASE_HOLD.
  */
-#define SSTVENC_PS_PHASE_RISE	 (1)
+#define SSTVENC_PS_PHASE_RISE	  (1)
 
 /*!
  * Hold state.  We maintain the pulse amplitude at its maximum for the
@@ -55,7 +55,7 @@ struct sstvenc_oscillator;
  * Otherwise, it will stay in this state indefinitely, code must call
  * @ref sstvenc_ps_advance manually to exit the hold state.
  */
-#define SSTVENC_PS_PHASE_HOLD	 (2)
+#define SSTVENC_PS_PHASE_HOLD	  (2)
 
 /*!
  * Falling slope.  The amplitude is being wound down to zero.
@@ -64,7 +64,7 @@ struct sstvenc_oscillator;
  * it reaches or exceeds sstvenc_pulseshape#fall_sz, the state machine resets
  * the counter and advances to SSTVENC_PS_PHASE_DONE.
  */
-#define SSTVENC_PS_PHASE_FALL	 (3)
+#define SSTVENC_PS_PHASE_FALL	  (3)
 
 /*!
  * Pulse finished.  The state machine will reset
@@ -72,7 +72,7 @@ struct sstvenc_oscillator;
  * increment it each sample whilst keeping sstvenc_pulseshape#output at
  * zero.
  */
-#define SSTVENC_PS_PHASE_DONE	 (4)
+#define SSTVENC_PS_PHASE_DONE	  (4)
 /*!
  * @}
  */
@@ -80,7 +80,51 @@ struct sstvenc_oscillator;
 /*!
  * Hold time = infinite.
  */
-#define SSTVENC_PS_HOLD_TIME_INF SSTVENC_TS_INFINITE
+#define SSTVENC_PS_HOLD_TIME_INF  SSTVENC_TS_INFINITE
+
+/*!
+ * @defgroup pulseshape_shapes Pulse Shaper Ramp Shapes
+ * @{
+ *
+ * The shape of the rise and fall ramps.  Each is given as the rising
+ * envelope `f(n)` for sample `n` of a ramp `N` samples long; the falling
+ * ramp is the mirror image.
+ */
+
+/*!
+ * Quarter-wave raised cosine: `f(n) = 1 - cos(πn / 2N)`.  This is the
+ * default.
+ */
+#define SSTVENC_PS_SHAPE_COSINE	  (0)
+
+/*!
+ * Rising half of a Hann window: `f(n) = ½ - ½·cos(πn / N)`.
+ */
+#define SSTVENC_PS_SHAPE_HANN	  (1)
+
+/*!
+ * Rising half of a Blackman window:
+ * `f(n) = 0.42 - ½·cos(πn / N) + 0.08·cos(2πn / N)`.  The smoothest of the
+ * three, with the lowest spectral splatter for a given ramp length.
+ */
+#define SSTVENC_PS_SHAPE_BLACKMAN (2)
+
+/*!
+ * @}
+ */
+
+/*!
+ * Size of the static pool holding envelope tables, in samples.  Tables are
+ * shared between all pulse shapers with the same ramp length and shape.  If
+ * a new table will not fit, the pulse shaper computes the envelope on each
+ * sample instead.
+ */
+#define SSTVENC_PS_TABLE_POOL_SZ  (16384)
+
+/*!
+ * Maximum number of distinct envelope tables held in the pool.
+ */
+#define SSTVENC_PS_TABLE_MAX	  (32)
 
 /*!
  * Pulse shaper data structure.  This should be initialised by calling
@@ -88,21 +132,34 @@ struct sstvenc_oscillator;
  */
 struct sstvenc_pulseshape {
 	/*! Peak amplitude of the pulse */
-	double	 amplitude;
+	double	      amplitude;
 	/*! The last computed output of the pulse shaper */
-	double	 output;
+	double	      output;
+	/*!
+	 * Normalised envelope table for the rising pulse, indexed by sample
+	 * number, or NULL if the envelope is computed on each sample.
+	 */
+	const double* rise_env;
+	/*!
+	 * Normalised envelope table for the falling pulse, indexed by the
+	 * number of samples remaining, or NULL if the envelope is computed on
+	 * each sample.
+	 */
+	const double* fall_env;
 	/*! Sample rate for the pulse in Hz */
-	uint32_t sample_rate;
+	uint32_t      sample_rate;
 	/*! Sample index for the current phase. */
-	uint32_t sample_idx;
+	uint32_t      sample_idx;
 	/*! Number of samples for the hold phase. */
-	uint32_t hold_sz;
+	uint32_t      hold_sz;
 	/*! Number of samples for the rising pulse. */
-	uint16_t rise_sz;
+	uint16_t      rise_sz;
 	/*! Number of samples for the falling pulse. */
-	uint16_t fall_sz;
+	uint16_t      fall_sz;
 	/*! Current pulse shaper phase. */
-	uint8_t	 phase;
+	uint8_t	      phase;
+	/*! Ramp shape, see @ref pulseshape_shapes */
+	uint8_t	      shape;
 };
 
 /*!
@@ -131,7 +188,9 @@ void   sstvenc_ps_reset(struct sstvenc_pulseshape* const ps, double hold_time,
 			uint8_t time_unit);
 
 /*!
- * Initialise a pulse shaper.
+ * Initialise a pulse shaper.  The ramps are given the
+ * @ref SSTVENC_PS_SHAPE_COSINE shape; use @ref sstvenc_ps_set_shape to
+ * change this.
  *
  * @param[out]	ps		The pulse shaper being initialised
  * @param[in]	amplitude	The peak amplitude for the pulse shaper
@@ -149,6 +208,17 @@ void   sstvenc_ps_init(struct sstvenc_pulseshape* const ps, double amplitude,
 		       double rise_time, double hold_time, double fall_time,
 		       uint32_t sample_rate, uint8_t time_unit);
 
+/*!
+ * Change the shape of the rise and fall ramps.  This should be done before
+ * the pulse starts.
+ *
+ * @param[inout]	ps		The pulse shaper being updated.
+ * @param[in]		shape		The new ramp shape, one of
+ * 					@ref pulseshape_shapes.
+ */
+void   sstvenc_ps_set_shape(struct sstvenc_pulseshape* const ps,
+			    uint8_t			     shape);
+
 /*!
  * Advance the pulse shaper to the next phase, regardless of whether it is
  * finished with the present one.  A no-op at the "done" phase.
@@ -167,6 +237,24 @@ void   sstvenc_ps_advance(struct sstvenc_pulseshape* const ps);
  */
 void   sstvenc_ps_compute(struct sstvenc_pulseshape* const ps);
 
+/*!
+ * Fill the given buffer with envelope samples from the pulse shaper.  This is
+ * equivalent to calling @ref sstvenc_ps_compute repeatedly and collecting
+ * sstvenc_pulseshape#output, stopping if we run out of buffer space or if
+ * the pulse shaper state machine finishes.  The hold phase is rendered as a
+ * single run and the rise and fall ramps are copied from the envelope
+ * tables where available.
+ *
+ * @param[inout]	ps		Pulse shaper state machine to pull
+ * 					envelope samples from.
+ * @param[out]		buffer		Buffer to write envelope samples to.
+ * @param[in]		buffer_sz	Size of the buffer in samples.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t sstvenc_ps_fill(struct sstvenc_pulseshape* const ps, double* buffer,
+		       size_t buffer_sz);
+
 /*!
  * Fill the given buffer with audio samples from the oscillator shaped with
  * the given pulse shaper.  Stop if we run out of buffer space or if the pulse
@@ -185,6 +273,25 @@ size_t sstvenc_psosc_fill_buffer(struct sstvenc_pulseshape* const ps,
 				 struct sstvenc_oscillator* const osc,
 				 double* buffer, size_t buffer_sz);
 
+/*!
+ * Fill the given buffer with single-precision audio samples from the
+ * oscillator shaped with the given pulse shaper.  The samples are computed in
+ * double precision and narrowed, see @ref sampfmt.  Otherwise identical to
+ * @ref sstvenc_psosc_fill_buffer.
+ *
+ * @param[inout]	ps		Pulse shaper state machine to pull
+ * 					envelope samples from.
+ * @param[inout]	osc		Sine wave oscillator.  Its amplitude
+ * 					will be modulated by the pulse shaper.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the audio buffer in samples.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t sstvenc_psosc_fill_buffer_f32(struct sstvenc_pulseshape* const ps,
+				     struct sstvenc_oscillator* const osc,
+				     float* buffer, size_t buffer_sz);
+
 /*! @} */
 
 #endif
@@ -0,0 +1,156 @@
+#ifndef _SSTVENC_RENDER_H
+#define _SSTVENC_RENDER_H
+
+/*!
+ * @defgroup render Multi-threaded rendering
+ * @{
+ *
+ * Routines that split the rendering of an SSTV transmission across several
+ * POSIX threads.
+ *
+ * The timing of an SSTV transmission is fixed by the mode, so the
+ * transmission can be cut into bands of samples which are rendered
+ * independently.  The modulator for each band is positioned with
+ * @ref sstvenc_modulator_skip, which walks the encoder a pulse at a time
+ * and carries the oscillator phase across each pulse.  So the bands join
+ * with continuous phase and the result is sample-for-sample identical to a
+ * single-threaded render (see @ref sstvenc_modulator_seek for the one
+ * exception, @ref SSTVENC_OSC_KERNEL_PHASOR).
+ *
+ * For many transmissions at once, @ref sstvenc_render_batch runs a list of
+ * jobs on a pool of threads, each job rendering one image start to finish.
+ */
+
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <libsstvenc/sstvmod.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*!
+ * Maximum number of threads a render may be split across.
+ */
+#define SSTVENC_RENDER_MAX_THREADS  (32)
+
+/*!
+ * Minimum number of samples given to each thread.  Shorter renders use
+ * fewer threads, as the cost of starting a thread outweighs the gain.
+ */
+#define SSTVENC_RENDER_MIN_BAND_SZ  (16384)
+
+/*!
+ * Number of samples a batch job renders at a time before handing them to
+ * its sink.  This buffer lives on the worker thread's stack.
+ */
+#define SSTVENC_RENDER_BLOCK_SZ	    (4096)
+
+/*!
+ * Sink for the samples of a batch job.  Called repeatedly with consecutive
+ * blocks of samples until the job's transmission is complete.
+ *
+ * @param[in]		ctx		sstvenc_render_job#sink_ctx
+ * @param[in]		samples		Block of samples
+ * @param[in]		samples_sz	Number of samples in the block
+ *
+ * @retval	0	Success, continue rendering
+ * @retval	<0	`-errno` error.  The job is abandoned and the error
+ * 			stored in sstvenc_render_job#result.
+ */
+typedef int sstvenc_render_sink(void* ctx, const double* samples,
+				size_t samples_sz);
+
+/*!
+ * A transmission to be rendered by @ref sstvenc_render_batch.  The caller
+ * fills in the inputs, the outputs are written when the job completes.
+ */
+struct sstvenc_render_job {
+	/*!
+	 * Transmission plan giving the mode and sample rate.  Jobs in the
+	 * same mode should share one plan.
+	 */
+	const struct sstvenc_mode_plan* plan;
+	/*! Framebuffer holding the image, see @ref sstvenc_encoder_init */
+	const uint8_t*			framebuffer;
+	/*! FSK ID to send at the end, NULL to disable */
+	const char*			fsk_id;
+	/*! Sink the samples are passed to */
+	sstvenc_render_sink*		sink;
+	/*! Context passed to @ref sstvenc_render_job#sink */
+	void*				sink_ctx;
+	/*! Carrier rise time, set to 0 to disable */
+	double				rise_time;
+	/*! Carrier fall time, set to 0 to disable */
+	double				fall_time;
+	/*! Total samples passed to the sink (output) */
+	uint64_t			samples;
+	/*!
+	 * Time spent rendering the job in nanoseconds, including the time
+	 * spent in the sink (output).  The job's throughput is
+	 * sstvenc_render_job#samples divided by this.
+	 */
+	uint64_t			elapsed_ns;
+	/*! 0 on success, or the error returned by the sink (output) */
+	int				result;
+	/*!
+	 * Time unit used to measure sstvenc_render_job#rise_time and
+	 * sstvenc_render_job#fall_time.
+	 */
+	uint8_t				time_unit;
+	/*! Oscillator sine kernel, one of @ref oscillator_kernels */
+	uint8_t				kernel;
+};
+
+/*!
+ * Fill the given buffer with audio samples from the SSTV modulator, using
+ * up to @a threads threads.  This produces the same samples as
+ * @ref sstvenc_modulator_fill_buffer and leaves the modulator in the same
+ * state, so the two may be mixed freely.
+ *
+ * The buffer is divided into bands of equal length, one per thread.  The
+ * calling thread positions a copy of the modulator at the start of each
+ * band, then renders the first band itself whilst the other threads render
+ * the rest.  If a thread cannot be started, its band is rendered by the
+ * calling thread.
+ *
+ * @param[inout]	mod		SSTV modulator state machine to pull
+ * 					samples from.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the audio buffer in samples.
+ * @param[in]		threads		Number of threads to use, at most
+ * 					@ref SSTVENC_RENDER_MAX_THREADS.  0
+ * 					or 1 renders in the calling thread.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t sstvenc_render_fill_buffer(struct sstvenc_mod* const mod,
+				  double* buffer, size_t buffer_sz,
+				  uint8_t threads);
+
+/*!
+ * Render a list of jobs on a pool of threads.  Idle threads take the next
+ * job not yet started, so long and short jobs balance out across the pool.
+ * The calling thread works through the list too, and finishes the batch on
+ * its own if no threads can be started.  Returns once every job is done.
+ *
+ * The sink of a job is only ever called from one thread at a time, but
+ * different jobs' sinks may be called concurrently.
+ *
+ * @param[inout]	jobs		Jobs to render
+ * @param[in]		jobs_sz		Number of jobs
+ * @param[in]		threads		Number of threads to use, at most
+ * 					@ref SSTVENC_RENDER_MAX_THREADS.  0
+ * 					uses one per online CPU.
+ *
+ * @retval	0	All jobs succeeded
+ * @retval	<0	Error from the first failing job's sink.  Check
+ * 			sstvenc_render_job#result for each job.
+ */
+int    sstvenc_render_batch(struct sstvenc_render_job* jobs, size_t jobs_sz,
+			    uint8_t threads);
+
+/*! @} */
+
+#endif
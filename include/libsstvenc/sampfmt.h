@@ -0,0 +1,252 @@
+#ifndef _SSTVENC_SAMPFMT_H
+#define _SSTVENC_SAMPFMT_H
+
+/*!
+ * @defgroup sampfmt Sample format conversion
+ * @{
+ *
+ * The generators in this library compute samples as double-precision
+ * values in the range [-1.0, 1.0].  The oscillator phase and pulse envelope
+ * need that precision to stay in tune over a whole transmission, but most
+ * audio sinks do not: they want narrower samples.  This module converts
+ * blocks of samples to those formats.
+ *
+ * Each generator also provides `_f32` and `_s16` variants of its fill
+ * function which render in blocks of @ref SSTVENC_SAMPFMT_BLOCK_SZ samples
+ * and narrow the result, so the caller only ever deals with the narrow
+ * buffer.  These share one block loop, @ref sstvenc_sampfmt_fill_f32 and
+ * @ref sstvenc_sampfmt_fill_s16, which other generators may use the same
+ * way.
+ *
+ * The module also converts the other way, widening stored samples back to
+ * double precision, as used by the Sun Audio decoder (@ref sunau).
+ *
+ * Hand-vectorised implementations exist for SSE2 and AVX2 on x86-64 and
+ * NEON on little-endian arm64, chosen at run time from
+ * @ref sstvenc_cpu_get_features as for @ref vecmath.  Every implementation
+ * gives bit-identical results to the portable scalar code for samples in
+ * the range [-1.0, 1.0].
+ */
+
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*!
+ * Number of double-precision samples rendered at a time by the narrow-format
+ * fill functions.  This scratch buffer lives on the stack.
+ */
+#define SSTVENC_SAMPFMT_BLOCK_SZ      (256)
+
+/*!
+ * @defgroup sampfmt_endian Integer sample byte orders
+ * @{
+ */
+
+/*! Samples are emitted in the host's byte order. */
+#define SSTVENC_SAMPFMT_ENDIAN_NATIVE (0)
+
+/*! Samples are emitted big-endian, as used by Sun Audio files. */
+#define SSTVENC_SAMPFMT_ENDIAN_BIG    (1)
+
+/*!
+ * @}
+ */
+
+/*!
+ * Convert double-precision samples to signed 8-bit linear PCM.  Samples are
+ * scaled by `INT8_MAX`, truncated towards zero and clipped to the range
+ * [-`INT8_MAX`, `INT8_MAX`].
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ */
+void sstvenc_sampfmt_f64_to_s8(int8_t* out, const double* in, size_t sz);
+
+/*!
+ * Convert double-precision samples to single-precision.
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ */
+void sstvenc_sampfmt_f64_to_f32(float* out, const double* in, size_t sz);
+
+/*!
+ * Convert double-precision samples to signed 16-bit linear PCM.  Samples are
+ * scaled by `INT16_MAX`, truncated towards zero and clipped to the range
+ * [-`INT16_MAX`, `INT16_MAX`].
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ * @param[in]		endianness	Byte order of the output, see
+ * 					@ref sampfmt_endian.
+ */
+void sstvenc_sampfmt_f64_to_s16(int16_t* out, const double* in, size_t sz,
+				uint8_t endianness);
+
+/*!
+ * Convert double-precision samples to signed 32-bit linear PCM.  Samples are
+ * scaled by `INT32_MAX`, truncated towards zero and clipped to the range
+ * [-`INT32_MAX`, `INT32_MAX`].
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ * @param[in]		endianness	Byte order of the output, see
+ * 					@ref sampfmt_endian.
+ */
+void sstvenc_sampfmt_f64_to_s32(int32_t* out, const double* in, size_t sz,
+				uint8_t endianness);
+
+/*!
+ * Convert double-precision samples to big-endian IEEE-754 single-precision,
+ * as stored in Sun Audio files.
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ */
+void sstvenc_sampfmt_f64_to_f32be(uint32_t* out, const double* in,
+				  size_t sz);
+
+/*!
+ * Convert double-precision samples to big-endian IEEE-754 double-precision,
+ * as stored in Sun Audio files.
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ */
+void sstvenc_sampfmt_f64_to_f64be(uint64_t* out, const double* in,
+				  size_t sz);
+
+/*!
+ * Source of double-precision samples for the narrow-format fill functions,
+ * normally a wrapper around a generator's fill function.
+ *
+ * @param[inout]	ctx		Generator context
+ * @param[out]		buffer		Buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the buffer in samples.
+ *
+ * @returns		Number of samples written to @a buffer.  Fewer than
+ * 			@a buffer_sz means the generator has finished.
+ */
+typedef size_t sstvenc_sampfmt_source(void* ctx, double* buffer,
+				      size_t buffer_sz);
+
+/*!
+ * Fill a buffer with single-precision samples from a double-precision
+ * source.  The source is asked for at most @ref SSTVENC_SAMPFMT_BLOCK_SZ
+ * samples at a time, and each block is converted with
+ * @ref sstvenc_sampfmt_f64_to_f32.
+ *
+ * @param[out]		out		Output buffer.
+ * @param[in]		out_sz		Size of the output buffer in samples.
+ * @param[in]		source		Source of the samples.
+ * @param[inout]	ctx		Context passed to @a source.
+ *
+ * @returns		Number of samples written to @a out.  This is less
+ * 			than @a out_sz only if the source finished.
+ */
+size_t sstvenc_sampfmt_fill_f32(float* out, size_t out_sz,
+				sstvenc_sampfmt_source* source, void* ctx);
+
+/*!
+ * Fill a buffer with signed 16-bit linear PCM samples from a
+ * double-precision source.  The source is asked for at most
+ * @ref SSTVENC_SAMPFMT_BLOCK_SZ samples at a time, and each block is
+ * converted with @ref sstvenc_sampfmt_f64_to_s16.
+ *
+ * @param[out]		out		Output buffer.
+ * @param[in]		out_sz		Size of the output buffer in samples.
+ * @param[in]		endianness	Byte order of the output, see
+ * 					@ref sampfmt_endian.
+ * @param[in]		source		Source of the samples.
+ * @param[inout]	ctx		Context passed to @a source.
+ *
+ * @returns		Number of samples written to @a out.  This is less
+ * 			than @a out_sz only if the source finished.
+ */
+size_t sstvenc_sampfmt_fill_s16(int16_t* out, size_t out_sz,
+				uint8_t endianness,
+				sstvenc_sampfmt_source* source, void* ctx);
+
+/*!
+ * @defgroup sampfmt_widen Widening conversions
+ * @{
+ *
+ * These convert stored samples back to double precision.  Integer samples
+ * are divided by the magnitude of the type's minimum, so the result lies in
+ * [-1.0, 1.0).
+ *
+ * To decode in place, the input may lie within the output buffer as long
+ * as it starts at least `sz × (sizeof(double) - sizeof(*in))` bytes in,
+ * e.g. in the last `sz × sizeof(*in)` bytes.  No other overlap is
+ * permitted.
+ */
+
+/*!
+ * Convert signed 8-bit linear PCM to double-precision.
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ */
+void sstvenc_sampfmt_s8_to_f64(double* out, const int8_t* in, size_t sz);
+
+/*!
+ * Convert signed 16-bit linear PCM to double-precision.
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ * @param[in]		endianness	Byte order of the input, see
+ * 					@ref sampfmt_endian.
+ */
+void sstvenc_sampfmt_s16_to_f64(double* out, const int16_t* in, size_t sz,
+				uint8_t endianness);
+
+/*!
+ * Convert signed 32-bit linear PCM to double-precision.
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ * @param[in]		endianness	Byte order of the input, see
+ * 					@ref sampfmt_endian.
+ */
+void sstvenc_sampfmt_s32_to_f64(double* out, const int32_t* in, size_t sz,
+				uint8_t endianness);
+
+/*!
+ * Convert big-endian IEEE-754 single-precision to double-precision.
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ */
+void sstvenc_sampfmt_f32be_to_f64(double* out, const uint32_t* in,
+				  size_t sz);
+
+/*!
+ * Convert big-endian IEEE-754 double-precision to host byte order.
+ *
+ * @param[out]		out		Output buffer, @a sz samples long.
+ * @param[in]		in		Input samples.
+ * @param[in]		sz		Number of samples to convert.
+ */
+void sstvenc_sampfmt_f64be_to_f64(double* out, const uint64_t* in,
+				  size_t sz);
+
+/*! @} */
+
+/*! @} */
+
+#endif
@@ -328,10 +328,17 @@
  */
 #define SSTVENC_SEQ_REG_DIT_PERIOD	    (5)
 
+/*!
+ * Oscillator sine kernel, one of @ref oscillator_kernels.  This applies to
+ * tones, CW and images begun after it is set.  A tone that follows on from
+ * another tone keeps the kernel it started with.
+ */
+#define SSTVENC_SEQ_REG_OSC_KERNEL	    (6)
+
 /*!
  * Total number of registers.
  */
-#define SSTVENC_SEQ_NUM_REGS		    (5)
+#define SSTVENC_SEQ_NUM_REGS		    (7)
 
 /*!
  * @}
@@ -838,4 +845,39 @@ void   sstvenc_sequencer_compute(struct sstvenc_sequencer* const seq);
 size_t sstvenc_sequencer_fill_buffer(struct sstvenc_sequencer* const seq,
 				     double* buffer, size_t buffer_sz);
 
+/*!
+ * Fill the given buffer with single-precision audio samples from the
+ * sequencer.  The samples are computed in double precision and narrowed, see
+ * @ref sampfmt.  Otherwise identical to @ref sstvenc_sequencer_fill_buffer.
+ *
+ * @param[inout]	seq		Sequencer state machine to pull
+ * 					samples from.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the audio buffer in samples.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t
+sstvenc_sequencer_fill_buffer_f32(struct sstvenc_sequencer* const seq,
+				  float* buffer, size_t buffer_sz);
+
+/*!
+ * Fill the given buffer with signed 16-bit linear PCM samples from the
+ * sequencer.  The samples are computed in double precision, then scaled,
+ * clipped and byte-swapped as described for @ref sstvenc_sampfmt_f64_to_s16.
+ * Otherwise identical to @ref sstvenc_sequencer_fill_buffer.
+ *
+ * @param[inout]	seq		Sequencer state machine to pull
+ * 					samples from.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the audio buffer in samples.
+ * @param[in]		endianness	Byte order of the samples, see
+ * 					@ref sampfmt_endian.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t sstvenc_sequencer_fill_s16(struct sstvenc_sequencer* const seq,
+				  int16_t* buffer, size_t buffer_sz,
+				  uint8_t endianness);
+
 #endif
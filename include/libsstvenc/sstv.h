@@ -35,6 +35,9 @@
  * SSTV image pulse.  Calling code may conclude the state machine is finished
  * when sstvenc_encoder#phase reaches SSTVENC_ENCODER_PHASE_DONE or when
  * @ref sstvenc_encoder_next_pulse returns NULL.
+ *
+ * Renderers that can work on arrays of pulses may instead call
+ * @ref sstvenc_encoder_next_pulses, which computes a run of pulses at a time.
  */
 
 /*
@@ -91,6 +94,49 @@ struct sstvenc_encoder;
  */
 typedef void sstvenc_encoder_callback(struct sstvenc_encoder* const enc);
 
+/* Forward declaration */
+struct sstvenc_encoder_channel;
+
+/*!
+ * Scan line emitter routine.  Computes the pixel pulses for a run of pixels
+ * of one scan line channel.  Pulse durations are filled in by the caller.
+ *
+ * @param[in]		chan		Scan line channel description
+ * @param[in]		px		Framebuffer value for the first pixel
+ * @param[out]		pulses		Array to write the pulses to
+ * @param[in]		count		Number of pixels to emit
+ */
+typedef void
+sstvenc_encoder_emitter(const struct sstvenc_encoder_channel* const chan,
+			const uint8_t*			      px,
+			struct sstvenc_encoder_pulse*	      pulses,
+			size_t				      count);
+
+/*!
+ * Description of how a scan line channel is read from the framebuffer.
+ * These are worked out from the mode's colour space in
+ * @ref sstvenc_encoder_init so that no colour space decisions need to be
+ * made whilst scanning.
+ */
+struct sstvenc_encoder_channel {
+	/*!
+	 * Emitter specialised for the channel's colour space.  NULL if the
+	 * mode does not use this channel.
+	 */
+	sstvenc_encoder_emitter* emit;
+	/*! Offset of the channel value from the pixel position */
+	uint32_t		 offset;
+	/*! Offset from the channel value to the value it is averaged with */
+	uint32_t		 pair;
+	/*! Whole nanoseconds in each pixel of the channel */
+	uint32_t		 px_ns;
+	/*!
+	 * Remainder of the channel period divided by the image width, spread
+	 * across the pixels so they add up to the channel period exactly.
+	 */
+	uint32_t		 px_rem;
+};
+
 /*!
  * SSTV encoder data structure.  This encodes the state of the encoder and
  * all the necessary oscillator and pulse shaper structures.
@@ -123,6 +169,9 @@ struct sstvenc_encoder {
 	/*! The current pulse being emitted */
 	struct sstvenc_encoder_pulse	    pulse;
 
+	/*! Scan line channels, indexed by channel number */
+	struct sstvenc_encoder_channel	    channel[4];
+
 	union sstvenc_encoder_phase_data {
 		struct sstvenc_encoder_phase_vis_data {
 			/*! The current bit being sent */
@@ -180,6 +229,28 @@ struct sstvenc_encoder {
 	uint8_t phase;
 };
 
+/*!
+ * Snapshot of the position of an SSTV encoder in its transmission.  This
+ * holds no pointers, so it may be saved and restored by a later process to
+ * continue the transmission, provided the library build, mode, FSK ID and
+ * image are the same.  It is stored in host byte order.
+ */
+struct sstvenc_encoder_snapshot {
+	/*! The current pulse being emitted */
+	struct sstvenc_encoder_pulse	 pulse;
+	/*! Phase-specific state, see sstvenc_encoder#vars */
+	union sstvenc_encoder_phase_data vars;
+	/*!
+	 * Position in the pulse sequence being emitted, or -1 if no pulse
+	 * sequence is being emitted.
+	 */
+	int16_t				 seq_idx;
+	/*! VIS code of the SSTV mode, used to check the snapshot fits */
+	uint8_t				 vis_code;
+	/*! The transmission phase, see @ref sstv_phase */
+	uint8_t				 phase;
+};
+
 /*!
  * Initialise the SSTV encoder with the given parameters.
  *
@@ -194,11 +265,84 @@ void sstvenc_encoder_init(struct sstvenc_encoder* const enc,
 			  const struct sstvenc_mode* mode, const char* fsk_id,
 			  const uint8_t* framebuffer);
 
+/*!
+ * Initialise the SSTV encoder using scan line channels previously computed
+ * with @ref sstvenc_encoder_channel_init.  This skips working out the
+ * channel layouts from the mode, which is useful when the same mode is
+ * encoded many times.
+ *
+ * @param[inout]	enc		SSTV encoder context to initialise
+ * @param[in]		mode		SSTV mode to encode
+ * @param[in]		fsk_id		FSK ID to send at the end, NULL to
+ * 					disable.
+ * @param[in]		framebuffer	Framebuffer data representing the
+ * 					image.
+ * @param[in]		channel		Array of 4 scan line channels computed
+ * 					for @a mode.
+ */
+void sstvenc_encoder_init_channels(
+    struct sstvenc_encoder* const enc, const struct sstvenc_mode* mode,
+    const char* fsk_id, const uint8_t* framebuffer,
+    const struct sstvenc_encoder_channel* channel);
+
+/*!
+ * Work out how a scan line channel of the given mode is read from the
+ * framebuffer and timed.
+ *
+ * @param[out]		chan		Scan line channel to initialise
+ * @param[in]		mode		SSTV mode
+ * @param[in]		ch		Scan line channel (0-3 inclusive)
+ */
+void sstvenc_encoder_channel_init(struct sstvenc_encoder_channel* const chan,
+				  const struct sstvenc_mode* mode,
+				  uint8_t		     ch);
+
 /*!
  * Compute the next pulse to be emitted.  This value returns NULL when there
- * are no more pulses to transmit.
+ * are no more pulses to transmit.  A run of pixels at the same level is
+ * returned as one pulse, see @ref SSTVENC_PULSE_FLAG_PIXEL.
  */
 const struct sstvenc_encoder_pulse*
 sstvenc_encoder_next_pulse(struct sstvenc_encoder* const enc);
 
+/*!
+ * Compute the next pulses to be emitted, up to @a max at a time.  This
+ * produces the same pulses as repeated calls to
+ * @ref sstvenc_encoder_next_pulse, but scan line channels are computed a run
+ * at a time, so a call can return a whole scan line of pulses.
+ *
+ * @param[inout]	enc		SSTV encoder context
+ * @param[out]		pulses		Array to write the pulses to
+ * @param[in]		max		Size of @a pulses
+ *
+ * @returns		Number of pulses written to @a pulses.  This is less
+ * 			than @a max only when the encoder has finished.
+ */
+size_t sstvenc_encoder_next_pulses(struct sstvenc_encoder* const enc,
+				   struct sstvenc_encoder_pulse* pulses,
+				   size_t			 max);
+
+/*!
+ * Record the position of the SSTV encoder in its transmission.
+ *
+ * @param[in]		enc		SSTV encoder context
+ * @param[out]		snap		Snapshot to write
+ */
+void sstvenc_encoder_snapshot(const struct sstvenc_encoder* const enc,
+			      struct sstvenc_encoder_snapshot* const snap);
+
+/*!
+ * Return the SSTV encoder to the position recorded in a snapshot.  The
+ * encoder must have been initialised with the same mode, FSK ID and image
+ * as the one the snapshot was taken from.
+ *
+ * @param[inout]	enc		SSTV encoder context
+ * @param[in]		snap		Snapshot to restore
+ *
+ * @retval	0		Success
+ * @retval	-EINVAL		The snapshot does not fit the encoder's mode.
+ */
+int  sstvenc_encoder_restore(struct sstvenc_encoder* const enc,
+			     const struct sstvenc_encoder_snapshot* snap);
+
 #endif
@@ -35,6 +35,16 @@
  */
 uint16_t sstvenc_level_freq(uint8_t level);
 
+/*!
+ * Compute the frequency that corresponds to the given signal level, without
+ * rounding to the nearest hertz.
+ *
+ * @param[in]	level	Signal level in Q8 fixed-point.
+ *
+ * @returns	Output frequency in hertz.
+ */
+double	 sstvenc_level_freq_exact(uint8_t level);
+
 /*!
  * @}
  * @}
@@ -32,6 +32,29 @@
 #include <libsstvenc/sstv.h>
 #include <stdint.h>
 
+/*!
+ * Transmission plan for an SSTV mode at a given sample rate.  This holds
+ * everything the modulator derives from the mode and sample rate, so that
+ * it is only worked out once when sending many images in the same mode.
+ *
+ * A plan is not modified by the modulators that use it, so one plan may be
+ * shared by any number of modulators, including from several threads.  The
+ * modulators copy what they need, so the plan need not outlive them.
+ */
+struct sstvenc_mode_plan {
+	/*! The SSTV mode the plan was computed for */
+	const struct sstvenc_mode*     mode;
+	/*! Scan line channel layouts and pixel timing */
+	struct sstvenc_encoder_channel channel[4];
+	/*!
+	 * Oscillator phase increment for each pixel level, computed for
+	 * the sample rate without rounding to the nearest hertz.
+	 */
+	uint32_t		       level_phase_inc[UINT8_MAX + 1];
+	/*! Sample rate in Hz the plan was computed for */
+	uint32_t		       sample_rate;
+};
+
 /*!
  * SSTV modulator data structure.
  */
@@ -42,14 +65,56 @@ struct sstvenc_mod {
 	struct sstvenc_oscillator osc;
 	/*! Pulse shaper */
 	struct sstvenc_pulseshape ps;
+	/*! Sample clock used to time the pulses */
+	struct sstvenc_ts_clock	  clock;
 	/*! Total audio samples emitted */
 	uint64_t		  total_samples;
 	/*! Total time period in nanoseconds emitted */
 	uint64_t		  total_ns;
+	/*!
+	 * Oscillator phase increment for each pixel level, computed for
+	 * the sample rate in use without rounding to the nearest hertz.
+	 */
+	uint32_t		  level_phase_inc[UINT8_MAX + 1];
 	/*! Remaining number of samples needed to correct timing */
 	uint32_t		  remaining;
 };
 
+/*!
+ * Snapshot of an SSTV modulator's progress through its transmission,
+ * taken with @ref sstvenc_modulator_snapshot.  Like
+ * struct sstvenc_encoder_snapshot, this holds no pointers and may be saved
+ * to a file so a long transmission can be rendered in stages.
+ */
+struct sstvenc_mod_snapshot {
+	/*! Encoder position */
+	struct sstvenc_encoder_snapshot enc;
+	/*! Total audio samples emitted, sstvenc_mod#total_samples */
+	uint64_t			total_samples;
+	/*! Total time emitted, sstvenc_mod#total_ns */
+	uint64_t			total_ns;
+	/*! Sample clock position, sstvenc_ts_clock#frac */
+	uint64_t			clock_frac;
+	/*! Oscillator amplitude, sstvenc_oscillator#amplitude */
+	double				osc_amplitude;
+	/*! Last oscillator output, sstvenc_oscillator#output */
+	double				osc_output;
+	/*! Last pulse shaper output, sstvenc_pulseshape#output */
+	double				ps_output;
+	/*! Oscillator phase, sstvenc_oscillator#phase */
+	uint32_t			osc_phase;
+	/*! Oscillator phase increment, sstvenc_oscillator#phase_inc */
+	uint32_t			osc_phase_inc;
+	/*! Pulse shaper position, sstvenc_pulseshape#sample_idx */
+	uint32_t			ps_sample_idx;
+	/*! Samples left in the current pulse, sstvenc_mod#remaining */
+	uint32_t			remaining;
+	/*! Sample rate, used to check the snapshot fits */
+	uint32_t			sample_rate;
+	/*! Pulse shaper phase, sstvenc_pulseshape#phase */
+	uint8_t				ps_phase;
+};
+
 /*!
  * Initialise the SSTV modulator with the given parameters.
  *
@@ -66,17 +131,144 @@ struct sstvenc_mod {
  * @param[in]		sample_rate	Sample rate in Hz
  * @param[in]		time_unit	Time unit used to measure @a rise_time
  * 					and @a fall_time.
+ * @param[in]		kernel		Oscillator sine kernel, one of
+ * 					@ref oscillator_kernels.
+ */
+void	 sstvenc_modulator_init(struct sstvenc_mod* const  mod,
+				const struct sstvenc_mode* mode,
+				const char*		   fsk_id,
+				const uint8_t* framebuffer, double rise_time,
+				double fall_time, uint32_t sample_rate,
+				uint8_t time_unit, uint8_t kernel);
+
+/*!
+ * Compute the transmission plan for an SSTV mode.
+ *
+ * @param[out]		plan		Transmission plan to initialise
+ * @param[in]		mode		SSTV mode to plan
+ * @param[in]		sample_rate	Sample rate in Hz
+ */
+void	 sstvenc_mode_plan_init(struct sstvenc_mode_plan* const plan,
+				const struct sstvenc_mode*	mode,
+				uint32_t			sample_rate);
+
+/*!
+ * Initialise the SSTV modulator from a transmission plan computed with
+ * @ref sstvenc_mode_plan_init.  The result is identical to calling
+ * @ref sstvenc_modulator_init with the plan's mode and sample rate.
+ *
+ * @param[inout]	mod		SSTV modulator context to initialise
+ * @param[in]		plan		Transmission plan for the mode
+ * @param[in]		fsk_id		FSK ID to send at the end, NULL to
+ * 					disable.
+ * @param[in]		framebuffer	Framebuffer data representing the
+ * 					image.
+ * @param[in]		rise_time	Carrier rise time, set to 0 to
+ * 					disable.
+ * @param[in]		fall_time	Carrier fall time, set to 0 to
+ * 					disable.
+ * @param[in]		time_unit	Time unit used to measure @a rise_time
+ * 					and @a fall_time.
+ * @param[in]		kernel		Oscillator sine kernel, one of
+ * 					@ref oscillator_kernels.
+ */
+void	 sstvenc_modulator_init_plan(struct sstvenc_mod* const	       mod,
+				     const struct sstvenc_mode_plan* plan,
+				     const char*		     fsk_id,
+				     const uint8_t* framebuffer,
+				     double rise_time, double fall_time,
+				     uint8_t time_unit, uint8_t kernel);
+
+/*!
+ * Compute the exact number of samples the SSTV modulator will emit for a
+ * transmission, i.e. the total of all calls to
+ * @ref sstvenc_modulator_fill_buffer (or the number of calls to
+ * @ref sstvenc_modulator_compute) until the pulse shaper reaches
+ * @ref SSTVENC_PS_PHASE_DONE.  This takes into account the rounding of
+ * pulse boundaries to the nearest sample and the carrier rise and fall, so
+ * may be used to size output buffers and files ahead of time.
+ *
+ * @param[in]		mode		SSTV mode to encode
+ * @param[in]		fsk_id		FSK ID to send at the end, NULL to
+ * 					disable.
+ * @param[in]		sample_rate	Sample rate in Hz
+ * @param[in]		rise_time	Carrier rise time, set to 0 to
+ * 					disable.
+ * @param[in]		fall_time	Carrier fall time, set to 0 to
+ * 					disable.
+ * @param[in]		time_unit	Time unit used to measure @a rise_time
+ * 					and @a fall_time.
+ *
+ * @returns	Number of samples in the transmission.
+ */
+uint64_t sstvenc_modulator_get_total_samples(
+    const struct sstvenc_mode* mode, const char* fsk_id, uint32_t sample_rate,
+    double rise_time, double fall_time, uint8_t time_unit);
+
+/*!
+ * Move the SSTV modulator to the given sample of its transmission, as if
+ * @ref sstvenc_modulator_compute had been called that many times since
+ * initialisation.  The modulator may be anywhere in its transmission.
+ *
+ * The encoder is walked forward a pulse at a time and the oscillator phase
+ * advanced over each pulse, so only the carrier rise and fall are computed
+ * sample by sample.  With @ref SSTVENC_OSC_KERNEL_PHASOR, the following
+ * samples may differ from a continuous run by the phasor's rounding error;
+ * see @ref sstvenc_osc_skip.
+ *
+ * @param[inout]	mod		SSTV modulator to move
+ * @param[in]		sample_idx	Index of the next sample to compute
+ *
+ * @returns	The index of the next sample to be computed.  This is less
+ * 		than @a sample_idx if the transmission ends first.
+ */
+uint64_t sstvenc_modulator_seek(struct sstvenc_mod* const mod,
+				uint64_t		  sample_idx);
+
+/*!
+ * Move the SSTV modulator forward by the given number of samples without
+ * computing them, as if @ref sstvenc_modulator_compute had been called that
+ * many times.  This works the same way as @ref sstvenc_modulator_seek, but
+ * from the modulator's current position.
+ *
+ * @param[inout]	mod		SSTV modulator to move
+ * @param[in]		samples		Number of samples to skip
+ *
+ * @returns	The number of samples skipped.  This is less than
+ * 		@a samples if the transmission ends first.
+ */
+uint64_t sstvenc_modulator_skip(struct sstvenc_mod* const mod,
+				uint64_t		  samples);
+
+/*!
+ * Record the SSTV modulator's progress through its transmission.
+ *
+ * @param[in]		mod		SSTV modulator
+ * @param[out]		snap		Snapshot to write
+ */
+void	 sstvenc_modulator_snapshot(const struct sstvenc_mod* const mod,
+				    struct sstvenc_mod_snapshot* const snap);
+
+/*!
+ * Continue a transmission from a snapshot.  The modulator must have been
+ * initialised with the same mode, FSK ID, image, carrier rise and fall
+ * times and sample rate as the one the snapshot was taken from.  The
+ * remarks about @ref SSTVENC_OSC_KERNEL_PHASOR in
+ * @ref sstvenc_modulator_seek apply here too.
+ *
+ * @param[inout]	mod		SSTV modulator
+ * @param[in]		snap		Snapshot to restore
+ *
+ * @retval	0		Success
+ * @retval	-EINVAL		The snapshot does not fit the modulator.
  */
-void   sstvenc_modulator_init(struct sstvenc_mod* const	 mod,
-			      const struct sstvenc_mode* mode,
-			      const char* fsk_id, const uint8_t* framebuffer,
-			      double rise_time, double fall_time,
-			      uint32_t sample_rate, uint8_t time_unit);
+int	 sstvenc_modulator_restore(struct sstvenc_mod* const	      mod,
+				   const struct sstvenc_mod_snapshot* snap);
 
 /*!
  * Compute the next audio sample to be emitted from the modulator.
  */
-void   sstvenc_modulator_compute(struct sstvenc_mod* const mod);
+void	 sstvenc_modulator_compute(struct sstvenc_mod* const mod);
 
 /*!
  * Fill the given buffer with audio samples from the SSTV modulator.  Stop if
@@ -90,8 +282,42 @@ void   sstvenc_modulator_compute(struct sstvenc_mod* const mod);
  *
  * @returns		Number of samples written to @a buffer
  */
-size_t sstvenc_modulator_fill_buffer(struct sstvenc_mod* const mod,
-				     double* buffer, size_t buffer_sz);
+size_t	 sstvenc_modulator_fill_buffer(struct sstvenc_mod* const mod,
+				       double* buffer, size_t buffer_sz);
+
+/*!
+ * Fill the given buffer with single-precision audio samples from the SSTV
+ * modulator.  The samples are computed in double precision and narrowed, see
+ * @ref sampfmt.  Otherwise identical to @ref sstvenc_modulator_fill_buffer.
+ *
+ * @param[inout]	mod		SSTV modulator state machine to pull
+ * 					samples from.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the audio buffer in samples.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t	 sstvenc_modulator_fill_buffer_f32(struct sstvenc_mod* const mod,
+					   float* buffer, size_t buffer_sz);
+
+/*!
+ * Fill the given buffer with signed 16-bit linear PCM samples from the SSTV
+ * modulator.  The samples are computed in double precision, then scaled,
+ * clipped and byte-swapped as described for @ref sstvenc_sampfmt_f64_to_s16.
+ * Otherwise identical to @ref sstvenc_modulator_fill_buffer.
+ *
+ * @param[inout]	mod		SSTV modulator state machine to pull
+ * 					samples from.
+ * @param[out]		buffer		Audio buffer to write samples to.
+ * @param[in]		buffer_sz	Size of the audio buffer in samples.
+ * @param[in]		endianness	Byte order of the samples, see
+ * 					@ref sampfmt_endian.
+ *
+ * @returns		Number of samples written to @a buffer
+ */
+size_t	 sstvenc_modulator_fill_s16(struct sstvenc_mod* const mod,
+				    int16_t* buffer, size_t buffer_sz,
+				    uint8_t endianness);
 
 /*!
  * @}
@@ -146,8 +146,37 @@ struct sstvenc_encoder_pulse {
 	 * is used to terminate an array of pulse definitions.
 	 */
 	uint32_t duration_ns;
+	/*!
+	 * The pixel level the frequency was computed from, see
+	 * @ref sstvenc_level_freq.  Only meaningful if
+	 * @ref SSTVENC_PULSE_FLAG_PIXEL is set in
+	 * sstvenc_encoder_pulse#flags.
+	 */
+	uint8_t	 level;
+	/*! Pulse flags, see @ref sstv_pulse_flags */
+	uint8_t	 flags;
 };
 
+/*!
+ * @defgroup sstv_pulse_flags SSTV pulse flags
+ * @{
+ */
+
+/*!
+ * The pulse encodes an image pixel.  sstvenc_encoder_pulse#frequency is
+ * rounded to the nearest hertz; a modulator may instead derive the exact
+ * frequency from sstvenc_encoder_pulse#level.
+ *
+ * Adjacent pixels of a scan line channel at the same level are sent as one
+ * pulse covering all of them, so a flat region of the image costs a single
+ * pulse.  The pulse lasts exactly as long as the pixels would separately.
+ */
+#define SSTVENC_PULSE_FLAG_PIXEL (0x01)
+
+/*!
+ * @}
+ */
+
 /*!
  * Description of a SSTV mode.  This encodes all of the specifications of a
  * given mode.
@@ -40,6 +40,20 @@
  * @}
  */
 
+/*!
+ * Number of samples an unbuffered encoder converts at a time before writing
+ * them out.  This scratch buffer lives on the stack, so a large write costs
+ * at most 4 kB of stack however many samples it carries.
+ */
+#define SSTVENC_SUNAU_BLOCK_SZ	   (512)
+
+/*!
+ * Sample count to give @ref sstvenc_sunau_enc_init_stream when the length
+ * of the stream is not known.  The header then carries the Sun Audio
+ * "unknown size" marker.
+ */
+#define SSTVENC_SUNAU_SIZE_UNKNOWN (SIZE_MAX)
+
 /*!
  * Encoder/decoder context.  Stores the fields necessary to construct the
  * header and the file pointer.
@@ -47,9 +61,32 @@
 struct sstvenc_sunau {
 	/*! Pointer to the open file for reading or writing */
 	FILE*	 fh;
+	/*!
+	 * Output buffer supplied with @ref sstvenc_sunau_enc_set_buffer,
+	 * or the sample data of a memory-mapped file.  NULL if the encoder
+	 * is unbuffered.
+	 */
+	uint8_t* buffer;
+	/*! Size of sstvenc_sunau#buffer in bytes */
+	size_t	 buffer_sz;
+	/*!
+	 * Number of bytes waiting in sstvenc_sunau#buffer, or the number
+	 * of bytes consumed when reading a memory-mapped file.
+	 */
+	size_t	 buffer_len;
+	/*!
+	 * File descriptor of a memory-mapped output (see
+	 * @ref sstvenc_sunau_enc_init_mmap), -1 otherwise.
+	 */
+	int	 fd;
 	/*! Number of bytes written, stores the size of the header when
 	 * reading */
 	uint32_t written_sz;
+	/*!
+	 * Data size in the file header in bytes, UINT32_MAX if unknown
+	 * (until an ordinary file is closed).
+	 */
+	uint32_t data_sz;
 	/*! File sample rate in Hz */
 	uint32_t sample_rate;
 	/*! Internal state */
@@ -139,10 +176,125 @@ int sstvenc_sunau_enc_init(struct sstvenc_sunau* const enc, const char* path,
 			   uint32_t sample_rate, uint8_t encoding,
 			   uint8_t channels);
 
+/*!
+ * Initialise an audio encoder context for a stream such as a pipe or
+ * socket.  The file is written in a single pass: the header carries the
+ * final data size from the outset, computed from @a n_samples (see
+ * @ref sstvenc_modulator_get_total_samples), so
+ * @ref sstvenc_sunau_enc_close never needs to seek back and patch it.
+ *
+ * A complete render writes exactly the promised count.  Should rendering
+ * stop early, closing pads the stream out with silence so it still matches
+ * its header.  Writing more than promised fails with `-ENOSPC`.  Pass
+ * @ref SSTVENC_SUNAU_SIZE_UNKNOWN if the length cannot be known; the
+ * header then says so and the stream ends wherever writing stops.
+ *
+ * @param[out]		enc		SunAU encoder context
+ * @param[inout]	fh		Existing file handle, open for writing
+ * 					in binary mode, e.g. `stdout`.
+ * @param[in]		sample_rate	Sample rate for the audio output in Hz
+ * @param[in]		encoding	Audio encoding for the output file
+ * @param[in]		channels	Number of channels in the audio file
+ * @param[in]		n_samples	Total number of samples (all channels)
+ * 					that will be written, or
+ * 					@ref SSTVENC_SUNAU_SIZE_UNKNOWN.
+ *
+ * @retval		0		Success
+ * @retval		-EINVAL		Invalid sample rate, encoding or
+ * 					channel count, or @a n_samples is not
+ * 					a multiple of @a channels
+ * @retval		-EFBIG		@a n_samples is too big for a Sun
+ * 					Audio file
+ */
+int sstvenc_sunau_enc_init_stream(struct sstvenc_sunau* const enc,
+				  FILE* fh, uint32_t sample_rate,
+				  uint8_t encoding, uint8_t channels,
+				  size_t n_samples);
+
+/*!
+ * Open a file for writing through a memory map, for when the number of
+ * samples is known up front (see @ref sstvenc_modulator_get_total_samples).
+ * The file is sized for @a n_samples samples and the header written with
+ * the final data size straight away.  Samples passed to
+ * @ref sstvenc_sunau_enc_write are converted directly into the mapped file,
+ * with no `stdio` copy and no header fix-up when the file is closed.
+ *
+ * The header in this mode is 32 bytes rather than 28, so the sample data
+ * starts 8-byte aligned within the mapping.
+ *
+ * Writing more than @a n_samples samples fails with `-ENOSPC`.  If fewer
+ * are written, @ref sstvenc_sunau_enc_close shrinks the file to fit.
+ * @ref sstvenc_sunau_enc_set_buffer may not be used in this mode.
+ *
+ * Build with `MISSING_POSIX_FALLOCATE` defined on platforms without
+ * `posix_fallocate()`; the file is then only extended with `ftruncate()`.
+ * If the file cannot be sized or mapped, it is removed again.
+ *
+ * @param[out]	enc		SunAU encoder context
+ * @param[in]	path		Path to the file to open for writing.
+ * @param[in]	sample_rate	Sample rate for the audio output in Hz
+ * @param[in]	encoding	Audio encoding for the output file
+ * @param[in]	channels	Number of channels in the audio file
+ * @param[in]	n_samples	Number of samples that will be written, a
+ * 				multiple of @a channels.
+ *
+ * @retval	0		Success
+ * @retval	-EINVAL		Invalid sample rate, encoding, channel count
+ * 				or sample count
+ * @retval	-EFBIG		The file would exceed the 4 GB limit of the
+ * 				format
+ * @retval	<0		`-errno` result from `open()`, `ftruncate()`,
+ * 				`posix_fallocate()` or `mmap()`.
+ */
+int sstvenc_sunau_enc_init_mmap(struct sstvenc_sunau* const enc,
+				const char* path, uint32_t sample_rate,
+				uint8_t encoding, uint8_t channels,
+				size_t n_samples);
+
+/*!
+ * Give the encoder a buffer to collect converted samples in.  Samples are
+ * converted straight into the buffer and only written to the file when it
+ * fills, so a caller writing one audio frame at a time makes one `fwrite()`
+ * call per buffer rather than per frame.  Any samples waiting in a previous
+ * buffer are written out first.
+ *
+ * Without a buffer, the encoder converts samples in blocks of
+ * @ref SSTVENC_SUNAU_BLOCK_SZ and writes each block as it goes.
+ *
+ * @param[inout]	enc		SunAU encoder context
+ * @param[in]		buffer		Buffer, aligned for a `double`.  Must
+ * 					remain valid until the encoder is
+ * 					closed or given another buffer.  NULL
+ * 					makes the encoder unbuffered.
+ * @param[in]		buffer_sz	Size of @a buffer in bytes
+ *
+ * @retval		0		Success
+ * @retval		-EINVAL		@a buffer cannot hold one sample, or
+ * 					the encoder writes through a memory
+ * 					map.
+ * @retval		<0		Write error `errno` from `fwrite()`
+ */
+int sstvenc_sunau_enc_set_buffer(struct sstvenc_sunau* const enc,
+				 void* buffer, size_t buffer_sz);
+
+/*!
+ * Write out any samples waiting in the encoder's buffer.  The samples are
+ * handed to `fwrite()`; this does not call `fflush()` on the file.  This
+ * does nothing for a memory-mapped file.
+ *
+ * @param[inout]	enc		SunAU encoder context
+ *
+ * @retval		0		Success
+ * @retval		<0		Write error `errno` from `fwrite()`
+ */
+int sstvenc_sunau_enc_flush(struct sstvenc_sunau* const enc);
+
 /*!
  * Write some audio samples to the file.  Audio is assumed to be a whole
  * number of audio frames, given as double-precision values in the range
- * [-1.0, 1.0] in the sample rate defined for the file.
+ * [-1.0, 1.0] in the sample rate defined for the file.  If the encoder has
+ * a buffer (see @ref sstvenc_sunau_enc_set_buffer), the samples may wait
+ * there until it fills or the file is closed.
  *
  * @param[inout]	enc		SunAU encoder context
  * @param[in]		n_samples	Number of samples in the buffer
@@ -151,19 +303,25 @@ int sstvenc_sunau_enc_init(struct sstvenc_sunau* const enc, const char* path,
  * @retval		0		Success
  * @retval		-EINVAL		Invalid number of samples (not a
  * multiple of `enc->channels`)
+ * @retval		-ENOSPC		More samples than a memory-mapped
+ * 					file was sized for (those that fit
+ * 					have been written), or than a stream
+ * 					promised (none have been written).
  * @retval		<0		Write error `errno` from `fwrite()`
  */
 int sstvenc_sunau_enc_write(struct sstvenc_sunau* const enc, size_t n_samples,
 			    const double* samples);
 
 /*!
- * Finish writing the file and close it.
+ * Write out any buffered samples, finish writing the file and close it.
+ * A stream with a known length is padded out with silence first.
  *
  * @param[inout]	enc		SunAU encoder context (to be closed)
  *
  * @retval		0		Success
  * @retval		<0		Write error `errno` from `fwrite()` or
- * `fclose()`.
+ * `fclose()`, or for a memory-mapped file, from `munmap()`, `ftruncate()`
+ * or `close()`.
  */
 int sstvenc_sunau_enc_close(struct sstvenc_sunau* const enc);
 
@@ -193,6 +351,44 @@ int sstvenc_sunau_dec_init_fh(struct sstvenc_sunau* const dec, FILE* fh);
  */
 int sstvenc_sunau_dec_init(struct sstvenc_sunau* const dec, const char* path);
 
+/*!
+ * Open a file for reading by mapping it into memory.  This suits short
+ * recordings that are replayed often, such as station identification
+ * announcements inserted between images: @ref sstvenc_sunau_dec_read
+ * converts straight from the mapping with no `read()` calls, and
+ * @ref sstvenc_sunau_dec_reset is free.  The raw sample data may also be
+ * accessed directly with @ref sstvenc_sunau_dec_get_data.
+ *
+ * The file descriptor is closed before this returns; only the mapping is
+ * kept until @ref sstvenc_sunau_dec_close.
+ *
+ * @param[out]	dec		SunAU decoder context
+ * @param[in]	path		Path to the file to open for reading.
+ *
+ * @retval	0		Success
+ * @retval	-EINVAL		Invalid sample rate, encoding or channel
+ * 				count, or not a regular Sun Audio file
+ * @retval	<0		`-errno` result from `open()`, `fstat()`,
+ * 				`pread()` or `mmap()`.
+ */
+int sstvenc_sunau_dec_init_mmap(struct sstvenc_sunau* const dec,
+				const char*		    path);
+
+/*!
+ * Retrieve the sample data of a memory-mapped file.  The samples are in
+ * the file's encoding and byte order (big-endian), interleaved by channel.
+ *
+ * @param[in]	dec		SunAU decoder context, opened with
+ * 				@ref sstvenc_sunau_dec_init_mmap
+ * @param[out]	n_samples	Number of samples in the data region
+ *
+ * @returns	Pointer to the start of the sample data, valid until
+ * 		@ref sstvenc_sunau_dec_close, or NULL if the file is not
+ * 		memory-mapped.
+ */
+const void* sstvenc_sunau_dec_get_data(const struct sstvenc_sunau* const dec,
+				       size_t* const n_samples);
+
 /*!
  * Reset the file back to the beginning.
  *
@@ -205,7 +401,8 @@ int sstvenc_sunau_dec_reset(struct sstvenc_sunau* const dec);
 
 /*!
  * Read some audio samples from the file.  n_samples is assumed to be a
- * multiple of the channel count.
+ * multiple of the channel count.  Memory-mapped files are converted
+ * straight from the mapping.
  *
  * @param[inout]	enc		SunAU decoder context
  * @param[inout]	n_samples	Number of samples in the buffer, will
@@ -226,12 +423,15 @@ int sstvenc_sunau_dec_read(struct sstvenc_sunau* const enc,
  * @param[inout]	dec		SunAU decoder context (to be closed)
  *
  * @retval		0		Success
- * @retval		<0		Write error `errno` from `fclose()`.
+ * @retval		<0		Write error `errno` from `fclose()` or
+ * 					`munmap()`.
  */
 int sstvenc_sunau_dec_close(struct sstvenc_sunau* const dec);
 
 /*!
- * Configure a sequencer step that emits an audio recording.
+ * Configure a sequencer step that emits an audio recording.  The file is
+ * memory-mapped where possible (see @ref sstvenc_sunau_dec_init_mmap),
+ * otherwise it is read with `stdio`.
  *
  * @param[out]		step		Sequencer step
  * @param[inout]	src		SunAU decoder state machine.
@@ -41,6 +41,22 @@
  * @}
  */
 
+/*!
+ * Sample clock.  This converts a sequence of time periods in nanoseconds to
+ * sample counts using integer arithmetic.  The exact (fractional) sample
+ * position is tracked so that the end of each period lands on the nearest
+ * sample boundary and rounding errors never accumulate.
+ */
+struct sstvenc_ts_clock {
+	/*!
+	 * Fractional part of the current sample position, in units of
+	 * 1/1000000000 of a sample, offset by half a sample for rounding.
+	 */
+	uint64_t frac;
+	/*! Sample rate in hertz. */
+	uint32_t sample_rate;
+};
+
 /*!
  * Obtain the scaling factor to convert 1 second of time to the given unit.
  *
@@ -94,6 +110,28 @@ uint32_t sstvenc_ts_unit_to_samples(double time, uint32_t sample_rate,
 double	 sstvenc_ts_samples_to_unit(uint32_t samples, uint32_t sample_rate,
 				    uint8_t unit);
 
+/*!
+ * Initialise a sample clock at time zero.
+ *
+ * @param[out]	clk		Sample clock to initialise.
+ * @param[in]	sample_rate	The sample rate in hertz being used for the
+ * 				discrete timebase.
+ */
+void	 sstvenc_ts_clock_init(struct sstvenc_ts_clock* const clk,
+			       uint32_t				sample_rate);
+
+/*!
+ * Advance the sample clock by the given time period.
+ *
+ * @param[inout]	clk		Sample clock to advance.
+ * @param[in]		duration_ns	Time period in nanoseconds.
+ *
+ * @returns	The number of samples from the rounded end of the previous
+ * 		period to the rounded end of this one.
+ */
+uint32_t sstvenc_ts_clock_advance(struct sstvenc_ts_clock* const clk,
+				  uint32_t			 duration_ns);
+
 /*! @} */
 
 #endif
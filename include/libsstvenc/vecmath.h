@@ -0,0 +1,79 @@
+#ifndef _SSTVENC_VECMATH_H
+#define _SSTVENC_VECMATH_H
+
+/*!
+ * @defgroup vecmath Vectorised maths kernels
+ * @{
+ *
+ * Block-oriented sine kernels, used by the polynomial oscillator kernel
+ * (@ref SSTVENC_OSC_KERNEL_POLY).  The sine is a degree-13 odd minimax
+ * polynomial which has a maximum absolute error of 4×10⁻¹⁴ over
+ * [-π/2, π/2].
+ *
+ * Hand-vectorised implementations exist for SSE2 and AVX2 on x86-64 and
+ * NEON on arm64.  The implementation is chosen at run time from
+ * @ref sstvenc_cpu_get_features, falling back to portable scalar code.  The
+ * SIMD implementations evaluate the same polynomial in the same order as the
+ * scalar code and agree with it to within 10⁻¹⁵ (they are bit-identical
+ * unless the compiler fuses multiply-adds in the scalar code).
+ */
+
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stddef.h>
+
+/*!
+ * Kernel implementations for a given instruction set.  Callers working
+ * through many blocks should fetch the table once with
+ * @ref sstvenc_vec_get_ops and call through it, rather than use
+ * @ref sstvenc_vec_sin and @ref sstvenc_vec_sin_env which look the table up
+ * on every call.
+ */
+struct sstvenc_vec_ops {
+	/*! Implementation of @ref sstvenc_vec_sin */
+	void (*sin)(double* y, const double* x, double amplitude, size_t sz);
+	/*! Implementation of @ref sstvenc_vec_sin_env */
+	void (*sin_env)(double* y, const double* x, const double* envelope,
+			size_t sz);
+};
+
+/*!
+ * Return the best kernels for the CPU features permitted by
+ * @ref sstvenc_cpu_set_features.  The choice for the host CPU is made once;
+ * a restriction is looked up on each call instead.
+ *
+ * @returns	Kernel table, valid for the life of the process.
+ */
+const struct sstvenc_vec_ops* sstvenc_vec_get_ops(void);
+
+/*!
+ * Compute `y[i] = amplitude × sin(x[i])`.
+ *
+ * @param[out]		y		Output buffer.  May be the same as
+ * 					@a x.
+ * @param[in]		x		Input angles in radians, which *MUST*
+ * 					lie in the range [-π/2, π/2].
+ * @param[in]		amplitude	Amplitude of the result.
+ * @param[in]		sz		Number of values to compute.
+ */
+void sstvenc_vec_sin(double* y, const double* x, double amplitude, size_t sz);
+
+/*!
+ * Compute `y[i] = envelope[i] × sin(x[i])`.
+ *
+ * @param[out]		y		Output buffer.  May be the same as
+ * 					@a x or @a envelope.
+ * @param[in]		x		Input angles in radians, which *MUST*
+ * 					lie in the range [-π/2, π/2].
+ * @param[in]		envelope	Per-value amplitude.
+ * @param[in]		sz		Number of values to compute.
+ */
+void sstvenc_vec_sin_env(double* y, const double* x, const double* envelope,
+			 size_t sz);
+
+/*! @} */
+
+#endif
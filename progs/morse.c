@@ -10,6 +10,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+/*!
+ * Size of the output buffer in `double`s.  Samples are written a frame at a
+ * time, so this collects them into large writes.
+ */
+#define AU_BUFFER_SZ (8192)
+
+/*! Output buffer for the SunAU encoder */
+static double au_buffer[AU_BUFFER_SZ];
+
 static void show_usage(const char* prog_name) {
 	printf("Usage: %s [options] \"MORSE CODE TEXT\" output.au\n"
 	       "Options:\n"
@@ -217,8 +226,8 @@ int main(int argc, char* argv[]) {
 	struct sstvenc_sunau  au;
 
 	sstvenc_cw_init(&cw, opt_input_txt, 1.0, opt_freq, opt_dit_period,
-			opt_slope_period, opt_rate,
-			SSTVENC_TS_UNIT_MILLISECONDS);
+			opt_slope_period, opt_rate, SSTVENC_TS_UNIT_MILLISECONDS,
+			SSTVENC_OSC_KERNEL_LIBM);
 	{
 		int res = sstvenc_sunau_enc_init(&au, opt_output_au, opt_rate,
 						 audio_encoding,
@@ -226,6 +235,9 @@ int main(int argc, char* argv[]) {
 		if (res < 0) {
 			fprintf(stderr, "Failed to open output file %s: %s\n",
 				opt_output_au, strerror(-res));
+		} else {
+			sstvenc_sunau_enc_set_buffer(&au, au_buffer,
+						     sizeof(au_buffer));
 		}
 	}
 
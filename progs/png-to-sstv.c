@@ -8,9 +8,19 @@
 #include <libsstvenc/sstvmod.h>
 #include <libsstvenc/sunau.h>
 #include <libsstvenc/yuv.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
+/*!
+ * Size of the output buffer in `double`s.  Samples are written a frame at a
+ * time, so this collects them into large writes.
+ */
+#define AU_BUFFER_SZ (8192)
+
+/*! Output buffer for the SunAU encoder */
+static double au_buffer[AU_BUFFER_SZ];
+
 static void show_modes(void) {
 	uint8_t			   idx	= 0;
 	const struct sstvenc_mode* mode = sstvenc_get_mode_by_idx(idx);
@@ -47,6 +57,7 @@ static void show_modes(void) {
 
 static void show_usage(const char* prog_name) {
 	printf("Usage: %s [options] input.png output.au\n"
+	       "Use - as the output to stream to standard output.\n"
 	       "Options:\n"
 	       "  {--bits | -B} BITS: set the number of bits per sample\n"
 	       "    8:    8-bit signed integer\n"
@@ -223,6 +234,7 @@ int main(int argc, char* argv[]) {
 	const struct sstvenc_mode* mode = sstvenc_get_mode_by_name(opt_mode);
 	struct sstvenc_mod	   mod;
 	struct sstvenc_sunau	   au;
+	bool			   au_buffered = true;
 
 	if (!mode) {
 		fprintf(stderr, "Unknown mode %s\n", opt_mode);
@@ -290,21 +302,57 @@ int main(int argc, char* argv[]) {
 	gdImageDestroy(im);
 
 	sstvenc_modulator_init(&mod, mode, opt_fsk_id, fb, 10.0, 10.0,
-			       opt_rate, SSTVENC_TS_UNIT_MILLISECONDS);
+			       opt_rate, SSTVENC_TS_UNIT_MILLISECONDS,
+			       SSTVENC_OSC_KERNEL_LIBM);
 	{
-		int res = sstvenc_sunau_enc_init(
-		    &au, opt_output_au, mod.osc.sample_rate, audio_encoding,
-		    total_audio_channels);
+		uint64_t n_samples = sstvenc_modulator_get_total_samples(
+		    mode, opt_fsk_id, opt_rate, 10.0, 10.0,
+		    SSTVENC_TS_UNIT_MILLISECONDS);
+		int res;
+
+		if (!strcmp(opt_output_au, "-")) {
+			/*
+			 * Stream to stdout in a single pass.  The header
+			 * states the full length up front, which the loop
+			 * below writes out exactly.
+			 */
+			res = sstvenc_sunau_enc_init_stream(
+			    &au, stdout, mod.osc.sample_rate, audio_encoding,
+			    total_audio_channels,
+			    n_samples * total_audio_channels);
+		} else {
+			/* Render straight into a mapped file if we can */
+			res = sstvenc_sunau_enc_init_mmap(
+			    &au, opt_output_au, mod.osc.sample_rate,
+			    audio_encoding, total_audio_channels,
+			    n_samples * total_audio_channels);
+			if (res == 0) {
+				au_buffered = false;
+			} else {
+				res = sstvenc_sunau_enc_init(
+				    &au, opt_output_au, mod.osc.sample_rate,
+				    audio_encoding, total_audio_channels);
+			}
+		}
+
 		if (res < 0) {
 			fprintf(stderr, "Failed to open output file %s: %s\n",
 				opt_output_au, strerror(-res));
+			return (2);
+		}
+
+		if (au_buffered) {
+			sstvenc_sunau_enc_set_buffer(&au, au_buffer,
+						     sizeof(au_buffer));
 		}
 	}
 
 	/*
-	 * Begin writing and computing the audio data.
+	 * Begin writing and computing the audio data.  Run until the carrier
+	 * has fallen away, so we write exactly the number of samples the
+	 * output was sized for.
 	 */
-	while (mod.enc.phase != SSTVENC_ENCODER_PHASE_DONE) {
+	while (mod.ps.phase < SSTVENC_PS_PHASE_DONE) {
 		/*
 		 * Our audio samples for this audio frame
 		 */
@@ -0,0 +1,448 @@
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * End-to-end encoder benchmark.  Every SSTV mode is rendered from the
+ * matching test card at each of the requested sample rates and output
+ * formats, and the throughput is reported as CSV.  Audio is written to
+ * /dev/null through the SunAU encoder, so the sample format conversion is
+ * measured but the speed of the disk is not.  Each transmission is rendered
+ * in its own child process, so the peak memory use reported is for that
+ * transmission alone.
+ */
+
+#include <errno.h>
+#include <gd.h>
+#include <getopt.h>
+#include <libsstvenc/sstvmod.h>
+#include <libsstvenc/sunau.h>
+#include <libsstvenc/yuv.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*!
+ * Number of samples rendered per call to the SunAU encoder.
+ */
+#define BENCH_BLOCK_SZ	     (4096)
+
+/*!
+ * Maximum number of sample rates or formats that may be given.
+ */
+#define BENCH_MAX_LIST_SZ    (16)
+
+/*!
+ * Test card used when there is none at the mode's resolution.
+ */
+#define BENCH_FALLBACK_CARD  "colour-320x256.png"
+
+/*!
+ * An output format to benchmark.
+ */
+struct bench_format {
+	/*! Name as given on the command line */
+	const char* name;
+	/*! SunAU encoding */
+	uint8_t	    encoding;
+};
+
+static void show_usage(const char* prog_name) {
+	printf("Usage: %s [options]\n"
+	       "Options:\n"
+	       "  {--bits | -B} BITS: comma-separated list of sample "
+	       "formats\n"
+	       "    8, 16, 32, 32s, 32f, 64 as for png-to-sstv "
+	       "(default 8,16,32f,64)\n"
+	       "  {--mode | -M} MODE: only benchmark the given SSTV mode\n"
+	       "  {--rate | -R} RATES: comma-separated list of sample rates "
+	       "in Hz\n"
+	       "    (default 8000,22050,48000,96000)\n"
+	       "  {--testcards | -t} DIR: directory holding the test cards "
+	       "(default testcards)\n"
+	       "\n"
+	       "Results are written to stdout as CSV, one row per mode, "
+	       "sample rate\n"
+	       "and format.\n",
+	       prog_name);
+}
+
+/*!
+ * Parse a comma-separated list of sample formats.  Returns the number of
+ * formats parsed, or 0 on error.
+ */
+static uint8_t parse_formats(char* list, struct bench_format* formats) {
+	uint8_t formats_sz = 0;
+
+	for (char* tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+		uint8_t encoding;
+
+		if (!strcmp(tok, "8")) {
+			encoding = SSTVENC_SUNAU_FMT_S8;
+		} else if (!strcmp(tok, "16")) {
+			encoding = SSTVENC_SUNAU_FMT_S16;
+		} else if (!strcmp(tok, "32") || !strcmp(tok, "32s")
+			   || !strcmp(tok, "32S")) {
+			encoding = SSTVENC_SUNAU_FMT_S32;
+		} else if (!strcmp(tok, "32f") || !strcmp(tok, "32F")) {
+			encoding = SSTVENC_SUNAU_FMT_F32;
+		} else if (!strcmp(tok, "64")) {
+			encoding = SSTVENC_SUNAU_FMT_F64;
+		} else {
+			fprintf(stderr, "Invalid sample format: %s\n", tok);
+			return 0;
+		}
+
+		if (formats_sz == BENCH_MAX_LIST_SZ) {
+			fprintf(stderr, "Too many sample formats\n");
+			return 0;
+		}
+
+		formats[formats_sz].name     = tok;
+		formats[formats_sz].encoding = encoding;
+		formats_sz++;
+	}
+
+	return formats_sz;
+}
+
+/*!
+ * Parse a comma-separated list of sample rates.  Returns the number of
+ * rates parsed, or 0 on error.
+ */
+static uint8_t parse_rates(char* list, uint32_t* rates) {
+	uint8_t rates_sz = 0;
+
+	for (char* tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+		char* endptr = NULL;
+		long  rate   = strtol(tok, &endptr, 10);
+
+		if ((rate <= 0) || (rate > UINT32_MAX) || *endptr) {
+			fprintf(stderr, "Invalid sample rate: %s\n", tok);
+			return 0;
+		}
+
+		if (rates_sz == BENCH_MAX_LIST_SZ) {
+			fprintf(stderr, "Too many sample rates\n");
+			return 0;
+		}
+
+		rates[rates_sz] = rate;
+		rates_sz++;
+	}
+
+	return rates_sz;
+}
+
+/*!
+ * Load the test card for the given mode into a framebuffer.  The card at
+ * the mode's resolution is used if there is one, otherwise the fallback
+ * card is scaled to fit.  Returns 0 on success, -1 on error.
+ */
+static int load_testcard(const char* dir, const struct sstvenc_mode* mode,
+			 uint8_t* fb) {
+	uint16_t colourspace
+	    = mode->colour_space_order & SSTVENC_CSO_MASK_MODE;
+	uint8_t colours = (colourspace == SSTVENC_CSO_MODE_MONO) ? 1 : 3;
+	char	path[1024];
+	FILE*	in;
+
+	snprintf(path, sizeof(path), "%s/%s-%ux%u.png", dir,
+		 (colours == 1) ? "mono" : "colour", mode->width,
+		 mode->height);
+	in = fopen(path, "rb");
+	if (!in) {
+		snprintf(path, sizeof(path), "%s/%s", dir,
+			 BENCH_FALLBACK_CARD);
+		in = fopen(path, "rb");
+	}
+	if (!in) {
+		perror(path);
+		return -1;
+	}
+
+	gdImagePtr im = gdImageCreateFromPng(in);
+	fclose(in);
+	if (!im) {
+		fprintf(stderr, "Failed to read test card %s\n", path);
+		return -1;
+	}
+
+	gdImagePtr im_resized = gdImageScale(im, mode->width, mode->height);
+
+	for (uint16_t y = 0; y < mode->height; y++) {
+		for (uint16_t x = 0; x < mode->width; x++) {
+			int c = gdImageGetTrueColorPixel(im_resized, x, y);
+			uint32_t idx = sstvenc_get_pixel_posn(mode, x, y);
+			uint8_t	 r   = gdTrueColorGetRed(c);
+			uint8_t	 g   = gdTrueColorGetGreen(c);
+			uint8_t	 b   = gdTrueColorGetBlue(c);
+
+			switch (colourspace) {
+			case SSTVENC_CSO_MODE_MONO:
+				fb[idx] = sstvenc_yuv_calc_y(r, g, b);
+				break;
+			case SSTVENC_CSO_MODE_RGB:
+				fb[idx]	    = r;
+				fb[idx + 1] = g;
+				fb[idx + 2] = b;
+				break;
+			case SSTVENC_CSO_MODE_YUV:
+			case SSTVENC_CSO_MODE_YUV2:
+				fb[idx]	    = sstvenc_yuv_calc_y(r, g, b);
+				fb[idx + 1] = sstvenc_yuv_calc_u(r, g, b);
+				fb[idx + 2] = sstvenc_yuv_calc_v(r, g, b);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	gdImageDestroy(im_resized);
+	gdImageDestroy(im);
+
+	return 0;
+}
+
+/*!
+ * Read the monotonic clock in seconds.
+ */
+static double bench_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec * 1.0e-9);
+}
+
+/*!
+ * Read the peak resident set size of this process in kiB.
+ */
+static long bench_peak_rss(void) {
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0) {
+		return -1;
+	}
+	return usage.ru_maxrss;
+}
+
+/*!
+ * Render one transmission to /dev/null and report the result as a CSV row.
+ * Returns 0 on success, or the `-errno` error from the SunAU encoder.
+ */
+static int bench_run(const struct sstvenc_mode* mode, const uint8_t* fb,
+		     uint32_t rate, const struct bench_format* format) {
+	struct sstvenc_mod   mod;
+	struct sstvenc_sunau au;
+	double		     buffer[BENCH_BLOCK_SZ];
+	uint64_t	     samples = 0;
+	double		     start;
+	double		     elapsed;
+	int		     res;
+
+	res = sstvenc_sunau_enc_init(&au, "/dev/null", rate,
+				     format->encoding, 1);
+	if (res < 0) {
+		return res;
+	}
+
+	start = bench_now();
+	sstvenc_modulator_init(&mod, mode, "BENCH", fb, 10.0, 10.0, rate,
+			       SSTVENC_TS_UNIT_MILLISECONDS,
+			       SSTVENC_OSC_KERNEL_LIBM);
+
+	while (1) {
+		size_t written_sz = sstvenc_modulator_fill_buffer(
+		    &mod, buffer, BENCH_BLOCK_SZ);
+
+		if (written_sz) {
+			res = sstvenc_sunau_enc_write(&au, written_sz,
+						      buffer);
+			if (res < 0) {
+				sstvenc_sunau_enc_close(&au);
+				return res;
+			}
+			samples += written_sz;
+		}
+
+		if (written_sz < BENCH_BLOCK_SZ) {
+			break;
+		}
+	}
+
+	res	= sstvenc_sunau_enc_close(&au);
+	elapsed = bench_now() - start;
+	if (res < 0) {
+		return res;
+	}
+
+	printf("%s,%u,%s,%llu,%.6f,%.0f,%.2f,%ld\n", mode->name, rate,
+	       format->name, (unsigned long long)samples, elapsed,
+	       samples / elapsed, (samples / (double)rate) / elapsed,
+	       bench_peak_rss());
+	fflush(stdout);
+
+	return 0;
+}
+
+/*!
+ * Run @ref bench_run in a child process, so the peak resident set size it
+ * reports covers that one transmission rather than every run so far.
+ * Returns 0 on success, or a `-errno` error.
+ */
+static int bench_run_child(const struct sstvenc_mode* mode,
+			   const uint8_t* fb, uint32_t rate,
+			   const struct bench_format* format) {
+	int   status;
+	pid_t pid;
+
+	/* Don't let the child inherit (and repeat) buffered output */
+	fflush(stdout);
+
+	pid = fork();
+	if (pid < 0) {
+		return -errno;
+	} else if (pid == 0) {
+		_exit(-bench_run(mode, fb, rate, format));
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		return -errno;
+	} else if (!WIFEXITED(status)) {
+		fprintf(stderr, "Benchmark killed by signal %d\n",
+			WTERMSIG(status));
+		return -EINTR;
+	} else {
+		return -WEXITSTATUS(status);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	char		    default_formats[] = "8,16,32f,64";
+	char		    default_rates[]   = "8000,22050,48000,96000";
+	const char*	    opt_testcards     = "testcards";
+	const char*	    opt_mode	      = NULL;
+	char*		    opt_formats	      = default_formats;
+	char*		    opt_rates	      = default_rates;
+	int		    opt_idx	      = 0;
+	struct bench_format formats[BENCH_MAX_LIST_SZ];
+	uint32_t	    rates[BENCH_MAX_LIST_SZ];
+	uint8_t		    formats_sz;
+	uint8_t		    rates_sz;
+	uint8_t		    mode_idx = 0;
+	int		    failures = 0;
+
+	static struct option long_options[] = {
+	    {.name    = "bits",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 'B'},
+	    {.name    = "mode",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 'M'},
+	    {.name    = "rate",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 'R'},
+	    {.name    = "testcards",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 't'},
+	    {.name = NULL, .has_arg = 0, .flag = NULL, .val = 0},
+	};
+
+	while (1) {
+		int c = getopt_long(argc, argv, "B:M:R:t:", long_options,
+				    &opt_idx);
+		if (c == -1) {
+			break;
+		} else if (!c && !long_options[opt_idx].flag) {
+			c = long_options[opt_idx].val;
+		}
+
+		switch (c) {
+		case 0:
+			break;
+		case 'B': /* Set sample formats */
+			opt_formats = optarg;
+			break;
+		case 'M': /* Set SSTV mode */
+			opt_mode = optarg;
+			break;
+		case 'R': /* Set sample rates */
+			opt_rates = optarg;
+			break;
+		case 't': /* Set test card directory */
+			opt_testcards = optarg;
+			break;
+		default:
+			show_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc) {
+		show_usage(argv[0]);
+		return 1;
+	}
+
+	formats_sz = parse_formats(opt_formats, formats);
+	rates_sz   = parse_rates(opt_rates, rates);
+	if (!formats_sz || !rates_sz) {
+		return 1;
+	}
+
+	if (opt_mode && !sstvenc_get_mode_by_name(opt_mode)) {
+		fprintf(stderr, "Unknown mode %s\n", opt_mode);
+		return 1;
+	}
+
+	printf("mode,sample_rate,format,samples,elapsed_s,samples_per_s,"
+	       "realtime_factor,peak_rss_kib\n");
+
+	for (const struct sstvenc_mode* mode = sstvenc_get_mode_by_idx(0);
+	     mode != NULL; mode = sstvenc_get_mode_by_idx(++mode_idx)) {
+		uint8_t* fb;
+
+		if (opt_mode && strcmp(mode->name, opt_mode)) {
+			continue;
+		}
+
+		fb = malloc(sstvenc_mode_get_fb_sz(mode));
+		if (!fb) {
+			perror("Failed to allocate framebuffer");
+			return 2;
+		}
+
+		if (load_testcard(opt_testcards, mode, fb) < 0) {
+			free(fb);
+			return 2;
+		}
+
+		for (uint8_t r = 0; r < rates_sz; r++) {
+			for (uint8_t f = 0; f < formats_sz; f++) {
+				int res = bench_run_child(
+				    mode, fb, rates[r], &(formats[f]));
+				if (res < 0) {
+					fprintf(stderr,
+						"%s at %u Hz, format %s: "
+						"%s\n",
+						mode->name, rates[r],
+						formats[f].name,
+						strerror(-res));
+					failures++;
+				}
+			}
+		}
+
+		free(fb);
+	}
+
+	return failures ? 2 : 0;
+}
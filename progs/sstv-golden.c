@@ -0,0 +1,621 @@
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Golden output checker.  Renders every SSTV mode, a CW message and a
+ * sequencer programme at fixed settings, so that changes to the library can
+ * be checked for unintended changes to the waveform.
+ *
+ * Scenarios using the exact oscillator kernels (libm and look-up table) are
+ * reduced to a 64-bit FNV-1a digest of the output samples.  Run without
+ * arguments before a change to record the digests, then with `-c` after the
+ * change to compare against them.  The digests depend on the C library's
+ * `sin()`, so only compare digests recorded on the same platform.
+ *
+ * Scenarios using the approximate kernels (phasor and polynomial) are
+ * rendered alongside the same scenario using the libm kernel, and fail if
+ * any sample differs by more than a tolerance.  These are checked on every
+ * run.
+ */
+
+#include <getopt.h>
+#include <libsstvenc/cw.h>
+#include <libsstvenc/oscillator.h>
+#include <libsstvenc/sampfmt.h>
+#include <libsstvenc/sequence.h>
+#include <libsstvenc/sstvmod.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*!
+ * Number of samples rendered at a time.
+ */
+#define GOLDEN_BLOCK_SZ		  (4096)
+
+/*!
+ * Default tolerance for approximate kernels.
+ */
+#define GOLDEN_DEFAULT_TOLERANCE  (1.0e-6)
+
+/*!
+ * Maximum length of a scenario name.
+ */
+#define GOLDEN_NAME_SZ		  (64)
+
+/*!
+ * Number of steps in the sequencer programme.
+ */
+#define GOLDEN_SEQ_STEPS	  (11)
+
+/*!
+ * FNV-1a 64-bit parameters.
+ */
+#define GOLDEN_FNV_OFFSET	  (0xcbf29ce484222325ULL)
+#define GOLDEN_FNV_PRIME	  (0x00000100000001b3ULL)
+
+/*!
+ * Scenario types
+ */
+#define GOLDEN_TYPE_SSTV	  (0) /*!< SSTV image, double samples */
+#define GOLDEN_TYPE_SSTV_S16	  (1) /*!< SSTV image, big-endian s16 */
+#define GOLDEN_TYPE_CW		  (2) /*!< CW message */
+#define GOLDEN_TYPE_SEQ		  (3) /*!< Sequencer programme */
+
+/*!
+ * A rendering scenario.
+ */
+struct golden_scenario {
+	/*! Name, used as the key in the digest file */
+	char			   name[GOLDEN_NAME_SZ];
+	/*! SSTV mode, for SSTV scenarios */
+	const struct sstvenc_mode* mode;
+	/*! Sample rate */
+	uint32_t		   sample_rate;
+	/*! Scenario type, one of GOLDEN_TYPE_* */
+	uint8_t			   type;
+	/*! Oscillator kernel */
+	uint8_t			   kernel;
+};
+
+/*!
+ * Source of samples for a scenario.
+ */
+struct golden_src {
+	union {
+		struct sstvenc_mod	 mod;
+		struct sstvenc_cw_mod	 cw;
+		struct sstvenc_sequencer seq;
+	};
+	/*! Sequencer programme, with this source's kernel selected */
+	struct sstvenc_sequencer_step seq_steps[GOLDEN_SEQ_STEPS];
+	uint8_t			      type;
+};
+
+/*!
+ * A digest read from the digest file.
+ */
+struct golden_entry {
+	char	 name[GOLDEN_NAME_SZ];
+	uint64_t samples;
+	uint64_t digest;
+	bool	 seen;
+};
+
+/*!
+ * Result of rendering a scenario.
+ */
+struct golden_result {
+	/*! Samples rendered */
+	uint64_t samples;
+	/*! Digest of the samples, for exact kernels */
+	uint64_t digest;
+	/*! Largest difference from the libm kernel, approximate kernels */
+	double	 max_err;
+	/*! Whether the sample count differed from the libm kernel */
+	bool	 length_mismatch;
+};
+
+static const char* const golden_fsk_id	= "VK4MSL";
+static const char* const golden_cw_text = "CQ CQ DE VK4MSL/P K";
+
+/*!
+ * Sequencer programme: a tuning tone, an image and a CW identification.
+ */
+static struct sstvenc_sequencer_step golden_seq_steps[GOLDEN_SEQ_STEPS];
+
+/*!
+ * Framebuffer for the sequencer programme's image.
+ */
+static uint8_t*			     golden_seq_fb;
+
+/*!
+ * Only run scenarios whose name starts with this, NULL for all.
+ */
+static const char*		     golden_only;
+
+static const char* const golden_kernel_names[] = {
+    [SSTVENC_OSC_KERNEL_LIBM]	= "libm",
+    [SSTVENC_OSC_KERNEL_LUT]	= "lut",
+    [SSTVENC_OSC_KERNEL_PHASOR] = "phasor",
+    [SSTVENC_OSC_KERNEL_POLY]	= "poly",
+};
+
+static void show_usage(const char* prog_name) {
+	printf("Usage: %s [options]\n"
+	       "Options:\n"
+	       "  {--check | -c} FILE: compare against digests previously "
+	       "written to FILE\n"
+	       "  {--only | -o} NAME: only run scenarios whose name starts "
+	       "with NAME\n"
+	       "  {--tolerance | -t} TOL: largest difference allowed "
+	       "between approximate\n"
+	       "    kernels and the libm kernel (default %g)\n"
+	       "\n"
+	       "Without --check, the digests are written to stdout.\n",
+	       prog_name, GOLDEN_DEFAULT_TOLERANCE);
+}
+
+/*!
+ * Whether the kernel is reproduced exactly from run to run.
+ */
+static bool golden_kernel_is_exact(uint8_t kernel) {
+	return (kernel == SSTVENC_OSC_KERNEL_LIBM)
+	       || (kernel == SSTVENC_OSC_KERNEL_LUT);
+}
+
+/*!
+ * Fill a framebuffer with a fixed pseudo-random pattern.
+ */
+static uint8_t* golden_make_fb(const struct sstvenc_mode* mode) {
+	size_t	 fb_sz = sstvenc_mode_get_fb_sz(mode);
+	uint8_t* fb    = malloc(fb_sz);
+	uint32_t state = 0x12345678;
+
+	if (!fb) {
+		perror("Failed to allocate framebuffer");
+		exit(2);
+	}
+
+	for (size_t i = 0; i < fb_sz; i++) {
+		state = (state * 1103515245u) + 12345u;
+		fb[i] = state >> 24;
+	}
+
+	return fb;
+}
+
+/*!
+ * Add bytes to a FNV-1a digest.
+ */
+static uint64_t golden_fnv(uint64_t digest, const uint8_t* data, size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		digest ^= data[i];
+		digest *= GOLDEN_FNV_PRIME;
+	}
+	return digest;
+}
+
+/*!
+ * Add double-precision samples to a digest.  For speed, each sample's bit
+ * pattern is mixed in as a single 64-bit word rather than byte by byte,
+ * which also makes the digest independent of the host byte order.
+ */
+static uint64_t golden_fnv_f64(uint64_t digest, const double* samples,
+			       size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		uint64_t bits;
+
+		memcpy(&bits, &(samples[i]), sizeof(bits));
+		digest ^= bits;
+		digest *= GOLDEN_FNV_PRIME;
+	}
+	return digest;
+}
+
+/*!
+ * Set up the sequencer programme.
+ */
+static void golden_seq_steps_init(void) {
+	const struct sstvenc_mode* mode = sstvenc_get_mode_by_name("R36");
+
+	golden_seq_fb = golden_make_fb(mode);
+
+	sstvenc_sequencer_step_set_timescale(
+	    &(golden_seq_steps[0]), SSTVENC_TS_UNIT_MILLISECONDS, false);
+	sstvenc_sequencer_step_set_reg(&(golden_seq_steps[1]),
+				       SSTVENC_SEQ_REG_OSC_KERNEL,
+				       SSTVENC_OSC_KERNEL_LIBM);
+	sstvenc_sequencer_step_set_reg(&(golden_seq_steps[2]),
+				       SSTVENC_SEQ_REG_FREQUENCY, 1900.0);
+	sstvenc_sequencer_step_tone(&(golden_seq_steps[3]), 300.0,
+				    SSTVENC_SEQ_SLOPE_BOTH);
+	sstvenc_sequencer_step_silence(&(golden_seq_steps[4]), 10.0);
+	sstvenc_sequencer_step_set_reg(&(golden_seq_steps[5]),
+				       SSTVENC_SEQ_REG_FREQUENCY, 1200.0);
+	sstvenc_sequencer_step_tone(&(golden_seq_steps[6]), 10.0,
+				    SSTVENC_SEQ_SLOPE_NONE);
+	sstvenc_sequencer_step_image(&(golden_seq_steps[7]), mode,
+				     golden_seq_fb, golden_fsk_id);
+	sstvenc_sequencer_step_silence(&(golden_seq_steps[8]), 250.0);
+	sstvenc_sequencer_step_cw(&(golden_seq_steps[9]), golden_cw_text);
+	sstvenc_sequencer_step_end(&(golden_seq_steps[10]));
+}
+
+/*!
+ * Prepare the sample source for a scenario with the given kernel.
+ */
+static void golden_src_init(struct golden_src* const		 src,
+			    const struct golden_scenario* const sc,
+			    const uint8_t* fb, uint8_t kernel) {
+	src->type = sc->type;
+
+	switch (sc->type) {
+	case GOLDEN_TYPE_SSTV:
+	case GOLDEN_TYPE_SSTV_S16:
+		sstvenc_modulator_init(&(src->mod), sc->mode, golden_fsk_id,
+				       fb, 10.0, 10.0, sc->sample_rate,
+				       SSTVENC_TS_UNIT_MILLISECONDS, kernel);
+		break;
+	case GOLDEN_TYPE_CW:
+		sstvenc_cw_init(&(src->cw), golden_cw_text, 1.0, 800.0, 60.0,
+				5.0, sc->sample_rate,
+				SSTVENC_TS_UNIT_MILLISECONDS, kernel);
+		break;
+	case GOLDEN_TYPE_SEQ:
+		memcpy(src->seq_steps, golden_seq_steps,
+		       sizeof(golden_seq_steps));
+		src->seq_steps[1].args.reg.value = kernel;
+		sstvenc_sequencer_init(&(src->seq), src->seq_steps, NULL,
+				       NULL, sc->sample_rate);
+		break;
+	}
+}
+
+/*!
+ * Render the next block of double-precision samples.
+ */
+static size_t golden_src_fill(struct golden_src* const src, double* buffer,
+			      size_t buffer_sz) {
+	switch (src->type) {
+	case GOLDEN_TYPE_SSTV:
+		return sstvenc_modulator_fill_buffer(&(src->mod), buffer,
+						     buffer_sz);
+	case GOLDEN_TYPE_CW:
+		return sstvenc_cw_fill_buffer(&(src->cw), buffer, buffer_sz);
+	case GOLDEN_TYPE_SEQ:
+		return sstvenc_sequencer_fill_buffer(&(src->seq), buffer,
+						     buffer_sz);
+	default:
+		return 0;
+	}
+}
+
+/*!
+ * Render a scenario.
+ */
+static void golden_run(const struct golden_scenario* const sc,
+		       struct golden_result* const	   res) {
+	static struct golden_src src;
+	static struct golden_src ref;
+	static double		 buffer[GOLDEN_BLOCK_SZ];
+	static double		 ref_buffer[GOLDEN_BLOCK_SZ];
+	static int16_t		 s16_buffer[GOLDEN_BLOCK_SZ];
+	uint8_t*		 fb	 = NULL;
+	bool			 exact	 = golden_kernel_is_exact(sc->kernel);
+	size_t			 written = 0;
+
+	if (sc->mode) {
+		fb = golden_make_fb(sc->mode);
+	}
+
+	memset(res, 0, sizeof(*res));
+	res->digest = GOLDEN_FNV_OFFSET;
+
+	golden_src_init(&src, sc, fb, sc->kernel);
+	if (!exact) {
+		golden_src_init(&ref, sc, fb, SSTVENC_OSC_KERNEL_LIBM);
+	}
+
+	do {
+		if (sc->type == GOLDEN_TYPE_SSTV_S16) {
+			written = sstvenc_modulator_fill_s16(
+			    &(src.mod), s16_buffer, GOLDEN_BLOCK_SZ,
+			    SSTVENC_SAMPFMT_ENDIAN_BIG);
+			res->digest = golden_fnv(
+			    res->digest, (const uint8_t*)s16_buffer,
+			    written * sizeof(int16_t));
+		} else {
+			written = golden_src_fill(&src, buffer,
+						  GOLDEN_BLOCK_SZ);
+			res->digest
+			    = golden_fnv_f64(res->digest, buffer, written);
+		}
+
+		if (!exact) {
+			size_t ref_written = golden_src_fill(
+			    &ref, ref_buffer, GOLDEN_BLOCK_SZ);
+
+			if (ref_written != written) {
+				res->length_mismatch = true;
+			}
+
+			for (size_t i = 0; (i < written) && (i < ref_written);
+			     i++) {
+				double err = fabs(buffer[i] - ref_buffer[i]);
+				if (err > res->max_err) {
+					res->max_err = err;
+				}
+			}
+		}
+
+		res->samples += written;
+	} while (written == GOLDEN_BLOCK_SZ);
+
+	free(fb);
+}
+
+/*!
+ * Read a digest file written by a previous run.  Returns the number of
+ * entries read, or -1 on error.
+ */
+static long golden_read_digests(const char* path,
+				struct golden_entry** entries) {
+	FILE*		     in		 = fopen(path, "r");
+	struct golden_entry* list	 = NULL;
+	size_t		     entries_sz	 = 0;
+	size_t		     entries_max = 0;
+	char		     line[256];
+
+	if (!in) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), in)) {
+		struct golden_entry entry;
+		unsigned long long  samples;
+		unsigned long long  digest;
+
+		if ((line[0] == '#') || (line[0] == '\n')) {
+			continue;
+		}
+
+		if (sscanf(line, "%63s %llu %llx", entry.name, &samples,
+			   &digest)
+		    != 3) {
+			fprintf(stderr, "%s: malformed line: %s", path, line);
+			fclose(in);
+			free(list);
+			return -1;
+		}
+
+		if (entries_sz == entries_max) {
+			struct golden_entry* new_list;
+
+			entries_max = entries_max ? (entries_max * 2) : 64;
+			new_list
+			    = realloc(list, entries_max * sizeof(*list));
+			if (!new_list) {
+				perror("Failed to allocate digests");
+				fclose(in);
+				free(list);
+				return -1;
+			}
+			list = new_list;
+		}
+
+		entry.samples	   = samples;
+		entry.digest	   = digest;
+		entry.seen	   = false;
+		list[entries_sz++] = entry;
+	}
+
+	fclose(in);
+	*entries = list;
+	return entries_sz;
+}
+
+/*!
+ * Render a scenario and check it, either against the recorded digests or
+ * against the libm kernel.  Returns true if the scenario passed.
+ */
+static bool golden_check(const struct golden_scenario* const sc,
+			 struct golden_entry* entries, long entries_sz,
+			 bool check, double tolerance) {
+	struct golden_result res;
+
+	if (golden_only
+	    && strncmp(sc->name, golden_only, strlen(golden_only))) {
+		return true;
+	}
+
+	golden_run(sc, &res);
+
+	if (!golden_kernel_is_exact(sc->kernel)) {
+		bool pass
+		    = !res.length_mismatch && (res.max_err <= tolerance);
+
+		if (check || !pass) {
+			fprintf(check ? stdout : stderr,
+				"%s: %s (%llu samples, max error %.3g)\n",
+				sc->name, pass ? "ok" : "FAIL",
+				(unsigned long long)res.samples,
+				res.max_err);
+		}
+		return pass;
+	}
+
+	if (!check) {
+		printf("%s %llu %016llx\n", sc->name,
+		       (unsigned long long)res.samples,
+		       (unsigned long long)res.digest);
+		return true;
+	}
+
+	for (long i = 0; i < entries_sz; i++) {
+		if (strcmp(entries[i].name, sc->name)) {
+			continue;
+		}
+
+		entries[i].seen = true;
+		if ((entries[i].samples == res.samples)
+		    && (entries[i].digest == res.digest)) {
+			printf("%s: ok\n", sc->name);
+			return true;
+		}
+
+		printf("%s: FAIL (%llu samples, digest %016llx; "
+		       "expected %llu samples, digest %016llx)\n",
+		       sc->name, (unsigned long long)res.samples,
+		       (unsigned long long)res.digest,
+		       (unsigned long long)entries[i].samples,
+		       (unsigned long long)entries[i].digest);
+		return false;
+	}
+
+	printf("%s: FAIL (not in digest file)\n", sc->name);
+	return false;
+}
+
+int main(int argc, char* argv[]) {
+	const char*	       opt_check     = NULL;
+	double		       opt_tolerance = GOLDEN_DEFAULT_TOLERANCE;
+	int		       opt_idx	     = 0;
+	struct golden_entry*   entries	     = NULL;
+	long		       entries_sz    = 0;
+	uint32_t	       failures	     = 0;
+	struct golden_scenario sc;
+
+	static struct option long_options[] = {
+	    {.name    = "check",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 'c'},
+	    {.name    = "only",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 'o'},
+	    {.name    = "tolerance",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 't'},
+	    {.name = NULL, .has_arg = 0, .flag = NULL, .val = 0},
+	};
+
+	while (1) {
+		int c = getopt_long(argc, argv, "c:o:t:", long_options,
+				    &opt_idx);
+		if (c == -1) {
+			break;
+		} else if (!c && !long_options[opt_idx].flag) {
+			c = long_options[opt_idx].val;
+		}
+
+		switch (c) {
+		case 0:
+			break;
+		case 'c': /* Check against digest file */
+			opt_check = optarg;
+			break;
+		case 'o': /* Select scenarios */
+			golden_only = optarg;
+			break;
+		case 't': /* Set tolerance */
+			opt_tolerance = atof(optarg);
+			break;
+		default:
+			show_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc) {
+		show_usage(argv[0]);
+		return 1;
+	}
+
+	if (opt_check) {
+		entries_sz = golden_read_digests(opt_check, &entries);
+		if (entries_sz < 0) {
+			return 2;
+		}
+	} else {
+		printf("# libsstvenc golden digests: name samples "
+		       "fnv1a64\n");
+	}
+
+	golden_seq_steps_init();
+
+	/* Every SSTV mode with every kernel, then with 16-bit output */
+	for (uint8_t idx = 0; sstvenc_get_mode_by_idx(idx); idx++) {
+		sc.mode	       = sstvenc_get_mode_by_idx(idx);
+		sc.sample_rate = 48000;
+
+		for (uint8_t k = 0; k <= SSTVENC_OSC_KERNEL_POLY; k++) {
+			sc.type	  = GOLDEN_TYPE_SSTV;
+			sc.kernel = k;
+			snprintf(sc.name, sizeof(sc.name), "sstv/%s/%s/%u",
+				 sc.mode->name, golden_kernel_names[k],
+				 sc.sample_rate);
+			failures += !golden_check(&sc, entries, entries_sz,
+						  opt_check, opt_tolerance);
+		}
+
+		/* A rate which is not a multiple of the pixel clock */
+		sc.sample_rate = 44100;
+		sc.kernel      = SSTVENC_OSC_KERNEL_LIBM;
+		snprintf(sc.name, sizeof(sc.name), "sstv/%s/libm/%u",
+			 sc.mode->name, sc.sample_rate);
+		failures += !golden_check(&sc, entries, entries_sz, opt_check,
+					  opt_tolerance);
+
+		sc.type	       = GOLDEN_TYPE_SSTV_S16;
+		sc.sample_rate = 48000;
+		snprintf(sc.name, sizeof(sc.name), "sstv-s16/%s/libm/%u",
+			 sc.mode->name, sc.sample_rate);
+		failures += !golden_check(&sc, entries, entries_sz, opt_check,
+					  opt_tolerance);
+	}
+
+	/* CW with every kernel */
+	sc.mode	       = NULL;
+	sc.type	       = GOLDEN_TYPE_CW;
+	sc.sample_rate = 48000;
+	for (uint8_t k = 0; k <= SSTVENC_OSC_KERNEL_POLY; k++) {
+		sc.kernel = k;
+		snprintf(sc.name, sizeof(sc.name), "cw/%s/%u",
+			 golden_kernel_names[k], sc.sample_rate);
+		failures += !golden_check(&sc, entries, entries_sz, opt_check,
+					  opt_tolerance);
+	}
+
+	/* The sequencer with every kernel */
+	sc.type = GOLDEN_TYPE_SEQ;
+	for (uint8_t k = 0; k <= SSTVENC_OSC_KERNEL_POLY; k++) {
+		sc.kernel = k;
+		snprintf(sc.name, sizeof(sc.name), "seq/%s/%u",
+			 golden_kernel_names[k], sc.sample_rate);
+		failures += !golden_check(&sc, entries, entries_sz, opt_check,
+					  opt_tolerance);
+	}
+
+	if (opt_check) {
+		for (long i = 0; i < entries_sz; i++) {
+			if (!entries[i].seen && !golden_only) {
+				printf("%s: not rendered, scenario "
+				       "removed?\n",
+				       entries[i].name);
+			}
+		}
+		printf("%u scenarios failed\n", failures);
+	}
+
+	free(entries);
+	free(golden_seq_fb);
+	return failures ? 1 : 0;
+}
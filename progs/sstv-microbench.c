@@ -0,0 +1,485 @@
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Per-module microbenchmarks.  Each benchmark drives a single library
+ * routine in a tight loop.  After some warm-up runs it is timed over a
+ * number of repeated runs, and the mean, spread and extremes of the time
+ * per operation are reported as CSV.
+ */
+
+#include <getopt.h>
+#include <libsstvenc/cw.h>
+#include <libsstvenc/oscillator.h>
+#include <libsstvenc/pulseshape.h>
+#include <libsstvenc/sequence.h>
+#include <libsstvenc/sstv.h>
+#include <libsstvenc/sstvmode.h>
+#include <libsstvenc/sunau.h>
+#include <libsstvenc/yuv.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*!
+ * Sample rate used for all benchmarks.
+ */
+#define MICRO_SAMPLE_RATE    (48000)
+
+/*!
+ * Number of samples written per call to the SunAU encoder.
+ */
+#define MICRO_BLOCK_SZ	     (4096)
+
+/*!
+ * Size of the image converted by the colour space benchmarks.
+ */
+#define MICRO_IMG_WIDTH	     (320)
+#define MICRO_IMG_HEIGHT     (256)
+#define MICRO_IMG_SZ	     (MICRO_IMG_WIDTH * MICRO_IMG_HEIGHT * 3)
+
+/*!
+ * Maximum number of timed runs.
+ */
+#define MICRO_MAX_RUNS	     (1000)
+
+/*!
+ * A microbenchmark.
+ */
+struct micro_bench {
+	/*! Name reported in the results */
+	const char* name;
+	/*! Prepare the benchmark state, may be NULL */
+	void (*init)(const struct micro_bench* const bench);
+	/*! Perform @a iterations iterations of the benchmark */
+	void (*run)(const struct micro_bench* const bench, size_t iterations);
+	/*! Release the benchmark state, may be NULL */
+	void (*done)(const struct micro_bench* const bench);
+	/*! Argument for the benchmark, e.g. the oscillator kernel */
+	uint8_t	    arg;
+	/*! Operations performed per iteration */
+	uint32_t    ops_per_iter;
+	/*! Iterations per run, before scaling */
+	uint32_t    iterations;
+};
+
+/*!
+ * Results are summed here so the compiler cannot discard the work.
+ */
+static volatile double		     micro_sink;
+
+/*!
+ * Benchmark state.  Only one benchmark is active at a time.
+ */
+static struct sstvenc_oscillator     micro_osc;
+static struct sstvenc_pulseshape     micro_ps;
+static struct sstvenc_encoder	     micro_enc;
+static struct sstvenc_cw_mod	     micro_cw;
+static struct sstvenc_sequencer	     micro_seq;
+static struct sstvenc_sequencer_step micro_seq_steps[6];
+static struct sstvenc_sunau	     micro_au;
+static const struct sstvenc_mode*    micro_mode;
+static uint8_t*			     micro_fb;
+static uint8_t			     micro_img[MICRO_IMG_SZ];
+static uint8_t			     micro_img_out[MICRO_IMG_SZ];
+static double			     micro_block[MICRO_BLOCK_SZ];
+
+static const char* const micro_cw_text = "CQ CQ DE VK4MSL K";
+
+static void micro_osc_init(const struct micro_bench* const bench) {
+	sstvenc_osc_init(&micro_osc, 1.0, 1500.0, 0.0, MICRO_SAMPLE_RATE,
+			 bench->arg);
+}
+
+static void micro_osc_run(const struct micro_bench* const bench,
+			  size_t			  iterations) {
+	double sum = 0.0;
+	(void)bench;
+
+	for (size_t i = 0; i < iterations; i++) {
+		sstvenc_osc_compute(&micro_osc);
+		sum += micro_osc.output;
+	}
+
+	micro_sink += sum;
+}
+
+static void micro_ps_init(const struct micro_bench* const bench) {
+	(void)bench;
+	sstvenc_ps_init(&micro_ps, 1.0, 2.0, 20.0, 2.0, MICRO_SAMPLE_RATE,
+			SSTVENC_TS_UNIT_MILLISECONDS);
+}
+
+static void micro_ps_run(const struct micro_bench* const bench,
+			 size_t				 iterations) {
+	double sum = 0.0;
+
+	for (size_t i = 0; i < iterations; i++) {
+		sstvenc_ps_compute(&micro_ps);
+		sum += micro_ps.output;
+		if (micro_ps.phase == SSTVENC_PS_PHASE_DONE) {
+			micro_ps_init(bench);
+		}
+	}
+
+	micro_sink += sum;
+}
+
+static void micro_enc_init(const struct micro_bench* const bench) {
+	size_t fb_sz;
+	(void)bench;
+
+	micro_mode = sstvenc_get_mode_by_name("M1");
+	fb_sz	   = sstvenc_mode_get_fb_sz(micro_mode);
+	micro_fb   = malloc(fb_sz);
+	for (size_t i = 0; i < fb_sz; i++) {
+		micro_fb[i] = (i * 7) ^ (i >> 5);
+	}
+	sstvenc_encoder_init(&micro_enc, micro_mode, "BENCH", micro_fb);
+}
+
+static void micro_enc_run(const struct micro_bench* const bench,
+			  size_t			  iterations) {
+	double sum = 0.0;
+	(void)bench;
+
+	for (size_t i = 0; i < iterations; i++) {
+		const struct sstvenc_encoder_pulse* pulse
+		    = sstvenc_encoder_next_pulse(&micro_enc);
+		if (pulse) {
+			sum += pulse->frequency;
+		} else {
+			sstvenc_encoder_init(&micro_enc, micro_mode, "BENCH",
+					     micro_fb);
+		}
+	}
+
+	micro_sink += sum;
+}
+
+static void micro_enc_done(const struct micro_bench* const bench) {
+	(void)bench;
+	free(micro_fb);
+	micro_fb = NULL;
+}
+
+static void micro_yuv_init(const struct micro_bench* const bench) {
+	(void)bench;
+	for (size_t i = 0; i < sizeof(micro_img); i++) {
+		micro_img[i] = (i * 13) ^ (i >> 7);
+	}
+}
+
+static void micro_yuv_run(const struct micro_bench* const bench,
+			  size_t			  iterations) {
+	(void)bench;
+
+	for (size_t i = 0; i < iterations; i++) {
+		sstvenc_rgb_to_yuv(micro_img_out, micro_img, MICRO_IMG_WIDTH,
+				   MICRO_IMG_HEIGHT);
+		micro_sink += micro_img_out[i % sizeof(micro_img_out)];
+	}
+}
+
+static void micro_cw_init(const struct micro_bench* const bench) {
+	sstvenc_cw_init(&micro_cw, micro_cw_text, 1.0, 800.0, 50.0, 5.0,
+			MICRO_SAMPLE_RATE, SSTVENC_TS_UNIT_MILLISECONDS,
+			bench->arg);
+}
+
+static void micro_cw_run(const struct micro_bench* const bench,
+			 size_t				 iterations) {
+	double sum = 0.0;
+
+	for (size_t i = 0; i < iterations; i++) {
+		sstvenc_cw_compute(&micro_cw);
+		sum += micro_cw.output;
+		if (micro_cw.state == SSTVENC_CW_MOD_STATE_DONE) {
+			micro_cw_init(bench);
+		}
+	}
+
+	micro_sink += sum;
+}
+
+static void micro_seq_init(const struct micro_bench* const bench) {
+	(void)bench;
+	sstvenc_sequencer_step_set_timescale(
+	    &(micro_seq_steps[0]), SSTVENC_TS_UNIT_MILLISECONDS, false);
+	sstvenc_sequencer_step_set_reg(&(micro_seq_steps[1]),
+				       SSTVENC_SEQ_REG_FREQUENCY, 1900.0);
+	sstvenc_sequencer_step_tone(&(micro_seq_steps[2]), 100.0,
+				    SSTVENC_SEQ_SLOPE_BOTH);
+	sstvenc_sequencer_step_silence(&(micro_seq_steps[3]), 50.0);
+	sstvenc_sequencer_step_cw(&(micro_seq_steps[4]), micro_cw_text);
+	sstvenc_sequencer_step_end(&(micro_seq_steps[5]));
+	sstvenc_sequencer_init(&micro_seq, micro_seq_steps, NULL, NULL,
+			       MICRO_SAMPLE_RATE);
+}
+
+static void micro_seq_run(const struct micro_bench* const bench,
+			  size_t			  iterations) {
+	double sum = 0.0;
+	(void)bench;
+
+	for (size_t i = 0; i < iterations; i++) {
+		sstvenc_sequencer_compute(&micro_seq);
+		sum += micro_seq.output;
+		if (micro_seq.state == SSTVENC_SEQ_STATE_DONE) {
+			sstvenc_sequencer_reset(&micro_seq);
+		}
+	}
+
+	micro_sink += sum;
+}
+
+static void micro_sunau_init(const struct micro_bench* const bench) {
+	for (size_t i = 0; i < MICRO_BLOCK_SZ; i++) {
+		micro_block[i] = sin(i * 0.1963);
+	}
+
+	if (sstvenc_sunau_enc_init(&micro_au, "/dev/null", MICRO_SAMPLE_RATE,
+				   bench->arg, 1)
+	    < 0) {
+		perror("Failed to open /dev/null");
+		exit(2);
+	}
+}
+
+static void micro_sunau_run(const struct micro_bench* const bench,
+			    size_t			    iterations) {
+	(void)bench;
+
+	for (size_t i = 0; i < iterations; i++) {
+		if (sstvenc_sunau_enc_write(&micro_au, MICRO_BLOCK_SZ,
+					    micro_block)
+		    < 0) {
+			perror("Failed to write audio samples");
+			exit(2);
+		}
+	}
+}
+
+static void micro_sunau_done(const struct micro_bench* const bench) {
+	(void)bench;
+	sstvenc_sunau_enc_close(&micro_au);
+}
+
+/*!
+ * The benchmarks, terminated by an entry with a NULL name.
+ */
+static const struct micro_bench micro_benches[] = {
+    {"osc_compute/libm", micro_osc_init, micro_osc_run, NULL,
+     SSTVENC_OSC_KERNEL_LIBM, 1, 1 << 20},
+    {"osc_compute/lut", micro_osc_init, micro_osc_run, NULL,
+     SSTVENC_OSC_KERNEL_LUT, 1, 1 << 20},
+    {"osc_compute/phasor", micro_osc_init, micro_osc_run, NULL,
+     SSTVENC_OSC_KERNEL_PHASOR, 1, 1 << 20},
+    {"osc_compute/poly", micro_osc_init, micro_osc_run, NULL,
+     SSTVENC_OSC_KERNEL_POLY, 1, 1 << 20},
+    {"ps_compute", micro_ps_init, micro_ps_run, NULL, 0, 1, 1 << 20},
+    {"encoder_next_pulse", micro_enc_init, micro_enc_run, micro_enc_done, 0,
+     1, 1 << 18},
+    {"rgb_to_yuv", micro_yuv_init, micro_yuv_run, NULL, 0,
+     MICRO_IMG_WIDTH * MICRO_IMG_HEIGHT, 16},
+    {"cw_compute", micro_cw_init, micro_cw_run, NULL, SSTVENC_OSC_KERNEL_LIBM,
+     1, 1 << 20},
+    {"sequencer_compute", micro_seq_init, micro_seq_run, NULL, 0, 1,
+     1 << 20},
+    {"sunau_write/s8", micro_sunau_init, micro_sunau_run, micro_sunau_done,
+     SSTVENC_SUNAU_FMT_S8, MICRO_BLOCK_SZ, 256},
+    {"sunau_write/s16", micro_sunau_init, micro_sunau_run, micro_sunau_done,
+     SSTVENC_SUNAU_FMT_S16, MICRO_BLOCK_SZ, 256},
+    {"sunau_write/s32", micro_sunau_init, micro_sunau_run, micro_sunau_done,
+     SSTVENC_SUNAU_FMT_S32, MICRO_BLOCK_SZ, 256},
+    {"sunau_write/f32", micro_sunau_init, micro_sunau_run, micro_sunau_done,
+     SSTVENC_SUNAU_FMT_F32, MICRO_BLOCK_SZ, 256},
+    {"sunau_write/f64", micro_sunau_init, micro_sunau_run, micro_sunau_done,
+     SSTVENC_SUNAU_FMT_F64, MICRO_BLOCK_SZ, 256},
+    {NULL, NULL, NULL, NULL, 0, 0, 0},
+};
+
+static void show_usage(const char* prog_name) {
+	printf("Usage: %s [options]\n"
+	       "Options:\n"
+	       "  {--bench | -b} NAME: only run benchmarks whose name "
+	       "starts with NAME\n"
+	       "  {--runs | -r} RUNS: number of timed runs (default 10)\n"
+	       "  {--scale | -s} SCALE: multiply the iterations per run by "
+	       "SCALE (default 1)\n"
+	       "  {--warmup | -w} RUNS: number of untimed warm-up runs "
+	       "(default 2)\n"
+	       "\n"
+	       "Results are written to stdout as CSV, one row per benchmark, "
+	       "with times\n"
+	       "in nanoseconds per operation.\n"
+	       "\n"
+	       "Benchmarks:\n",
+	       prog_name);
+
+	for (const struct micro_bench* bench = micro_benches; bench->name;
+	     bench++) {
+		printf("  %s\n", bench->name);
+	}
+}
+
+/*!
+ * Read the monotonic clock in nanoseconds.
+ */
+static uint64_t micro_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*!
+ * Run a benchmark and report the result as a CSV row.
+ */
+static void micro_run(const struct micro_bench* const bench, uint16_t runs,
+		      uint16_t warmup, uint32_t scale) {
+	static double ns_per_op[MICRO_MAX_RUNS];
+	size_t	      iterations = (size_t)bench->iterations * scale;
+	double	      ops	 = (double)iterations * bench->ops_per_iter;
+	double	      mean	 = 0.0;
+	double	      var	 = 0.0;
+	double	      min	 = INFINITY;
+	double	      max	 = 0.0;
+
+	if (bench->init) {
+		bench->init(bench);
+	}
+
+	for (uint16_t i = 0; i < warmup; i++) {
+		bench->run(bench, iterations);
+	}
+
+	for (uint16_t i = 0; i < runs; i++) {
+		uint64_t start = micro_now_ns();
+		bench->run(bench, iterations);
+		ns_per_op[i] = (micro_now_ns() - start) / ops;
+	}
+
+	if (bench->done) {
+		bench->done(bench);
+	}
+
+	for (uint16_t i = 0; i < runs; i++) {
+		mean += ns_per_op[i];
+		if (ns_per_op[i] < min) {
+			min = ns_per_op[i];
+		}
+		if (ns_per_op[i] > max) {
+			max = ns_per_op[i];
+		}
+	}
+	mean /= runs;
+
+	/* Sample variance over the timed runs */
+	for (uint16_t i = 0; i < runs; i++) {
+		var += (ns_per_op[i] - mean) * (ns_per_op[i] - mean);
+	}
+	if (runs > 1) {
+		var /= (runs - 1);
+	}
+
+	printf("%s,%.0f,%u,%.4f,%.4f,%.2f,%.4f,%.4f,%.3f\n", bench->name, ops,
+	       runs, mean, sqrt(var), (100.0 * sqrt(var)) / mean, min, max,
+	       1.0e3 / mean);
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+	const char* opt_bench  = NULL;
+	int	    opt_runs   = 10;
+	int	    opt_warmup = 2;
+	int	    opt_scale  = 1;
+	int	    opt_idx    = 0;
+
+	static struct option long_options[] = {
+	    {.name    = "bench",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 'b'},
+	    {.name    = "runs",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 'r'},
+	    {.name    = "scale",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 's'},
+	    {.name    = "warmup",
+	     .has_arg = required_argument,
+	     .flag    = NULL,
+	     .val     = 'w'},
+	    {.name = NULL, .has_arg = 0, .flag = NULL, .val = 0},
+	};
+
+	while (1) {
+		int c = getopt_long(argc, argv, "b:r:s:w:", long_options,
+				    &opt_idx);
+		if (c == -1) {
+			break;
+		} else if (!c && !long_options[opt_idx].flag) {
+			c = long_options[opt_idx].val;
+		}
+
+		switch (c) {
+		case 0:
+			break;
+		case 'b': /* Select benchmarks */
+			opt_bench = optarg;
+			break;
+		case 'r': /* Set number of timed runs */
+			opt_runs = atoi(optarg);
+			break;
+		case 's': /* Set iteration scale */
+			opt_scale = atoi(optarg);
+			break;
+		case 'w': /* Set number of warm-up runs */
+			opt_warmup = atoi(optarg);
+			break;
+		default:
+			show_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc) {
+		show_usage(argv[0]);
+		return 1;
+	}
+
+	if ((opt_runs < 1) || (opt_runs > MICRO_MAX_RUNS)) {
+		fprintf(stderr, "Number of runs must be between 1 and %d\n",
+			MICRO_MAX_RUNS);
+		return 1;
+	}
+
+	if ((opt_warmup < 0) || (opt_warmup > UINT16_MAX)
+	    || (opt_scale < 1)) {
+		fprintf(stderr, "Invalid warm-up runs or scale\n");
+		return 1;
+	}
+
+	printf("bench,ops_per_run,runs,mean_ns_per_op,stddev_ns_per_op,"
+	       "cv_percent,min_ns_per_op,max_ns_per_op,mops_per_s\n");
+
+	for (const struct micro_bench* bench = micro_benches; bench->name;
+	     bench++) {
+		if (opt_bench
+		    && strncmp(bench->name, opt_bench, strlen(opt_bench))) {
+			continue;
+		}
+
+		micro_run(bench, opt_runs, opt_warmup, opt_scale);
+	}
+
+	return 0;
+}
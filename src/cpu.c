@@ -0,0 +1,68 @@
+/*!
+ * @addtogroup cpu
+ * @{
+ */
+
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <libsstvenc/cpu.h>
+#include <pthread.h>
+
+#if defined(__arm__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+/*!
+ * Features supported by the host CPU.
+ */
+static uint32_t	      sstvenc_cpu_detected = 0;
+
+/*!
+ * Features the caller permits us to use.
+ */
+static uint32_t	      sstvenc_cpu_allowed  = SSTVENC_CPU_FEAT_ALL;
+
+/*!
+ * Guard for one-time feature detection.
+ */
+static pthread_once_t sstvenc_cpu_once	   = PTHREAD_ONCE_INIT;
+
+/*!
+ * Probe the host CPU for supported features.
+ */
+static void sstvenc_cpu_probe(void) {
+#if defined(__x86_64__) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		sstvenc_cpu_detected |= SSTVENC_CPU_FEAT_SSE2;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		sstvenc_cpu_detected |= SSTVENC_CPU_FEAT_AVX2;
+	}
+#elif defined(__aarch64__)
+	sstvenc_cpu_detected |= SSTVENC_CPU_FEAT_NEON;
+#elif defined(__arm__) && defined(__linux__) && defined(HWCAP_NEON)
+	if (getauxval(AT_HWCAP) & HWCAP_NEON) {
+		sstvenc_cpu_detected |= SSTVENC_CPU_FEAT_NEON;
+	}
+#endif
+}
+
+uint32_t sstvenc_cpu_detect(void) {
+	pthread_once(&sstvenc_cpu_once, sstvenc_cpu_probe);
+	return sstvenc_cpu_detected;
+}
+
+uint32_t sstvenc_cpu_get_features(void) {
+	return sstvenc_cpu_detect() & sstvenc_cpu_allowed;
+}
+
+void sstvenc_cpu_set_features(uint32_t features) {
+	sstvenc_cpu_allowed = features;
+}
+
+/*! @} */
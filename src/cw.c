@@ -4,6 +4,7 @@
  */
 
 #include <libsstvenc/cw.h>
+#include <libsstvenc/sampfmt.h>
 #include <string.h>
 
 /*!
@@ -312,11 +313,12 @@ static void sstvenc_cw_handle_state_done(struct sstvenc_cw_mod* const cw);
 void	    sstvenc_cw_init(struct sstvenc_cw_mod* const cw, const char* text,
 			    double amplitude, double frequency, double dit_period,
 			    double slope_period, uint32_t sample_rate,
-			    uint8_t time_unit) {
+			    uint8_t time_unit, uint8_t kernel) {
 
 	       sstvenc_ps_init(&(cw->ps), amplitude, slope_period, INFINITY,
 			       slope_period, sample_rate, time_unit);
-	       sstvenc_osc_init(&(cw->osc), 1.0, frequency, 0.0, sample_rate);
+	       sstvenc_osc_init(&(cw->osc), 1.0, frequency, 0.0, sample_rate,
+				kernel);
 	       cw->dit_period
 		   = sstvenc_ts_unit_to_samples(dit_period, sample_rate, time_unit);
 	       cw->pos	       = 0;
@@ -531,6 +533,30 @@ size_t sstvenc_cw_fill_buffer(struct sstvenc_cw_mod* const cw, double* buffer,
 	size_t written_sz = 0;
 
 	while ((buffer_sz > 0) && (cw->state < SSTVENC_CW_MOD_STATE_DONE)) {
+		if ((cw->state == SSTVENC_CW_MOD_STATE_MARK)
+		    && (cw->ps.phase > SSTVENC_PS_PHASE_INIT)
+		    && (cw->ps.phase < SSTVENC_PS_PHASE_DONE)
+		    && (cw->symbol->value[cw->pos] != ' ')) {
+			/*
+			 * Dah/Dit in progress, render the rest of the
+			 * envelope and modulate the oscillator with it.
+			 * The oscillator runs at full amplitude during a
+			 * mark, so the envelope alone sets the level.
+			 */
+			const double amplitude = cw->osc.amplitude;
+			size_t	     sz
+			    = sstvenc_ps_fill(&(cw->ps), buffer, buffer_sz);
+
+			sstvenc_osc_fill_env(&(cw->osc), buffer, buffer, sz);
+			cw->osc.amplitude = amplitude;
+			cw->output	  = buffer[sz - 1];
+
+			buffer	   += sz;
+			buffer_sz  -= sz;
+			written_sz += sz;
+			continue;
+		}
+
 		sstvenc_cw_compute(cw);
 
 		buffer[0] = cw->output;
@@ -543,6 +569,25 @@ size_t sstvenc_cw_fill_buffer(struct sstvenc_cw_mod* const cw, double* buffer,
 	return written_sz;
 }
 
+/*!
+ * Sample source for the narrow-format fill functions, see @ref sampfmt.
+ */
+static size_t sstvenc_cw_source(void* ctx, double* buffer, size_t buffer_sz) {
+	return sstvenc_cw_fill_buffer(ctx, buffer, buffer_sz);
+}
+
+size_t sstvenc_cw_fill_buffer_f32(struct sstvenc_cw_mod* const cw,
+				  float* buffer, size_t buffer_sz) {
+	return sstvenc_sampfmt_fill_f32(buffer, buffer_sz, sstvenc_cw_source,
+					cw);
+}
+
+size_t sstvenc_cw_fill_s16(struct sstvenc_cw_mod* const cw, int16_t* buffer,
+			   size_t buffer_sz, uint8_t endianness) {
+	return sstvenc_sampfmt_fill_s16(buffer, buffer_sz, endianness,
+					sstvenc_cw_source, cw);
+}
+
 /*!
  * @}
  */
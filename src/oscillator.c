@@ -10,7 +10,11 @@
 
 #include <assert.h>
 #include <libsstvenc/oscillator.h>
+#include <libsstvenc/vecmath.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /*!
@@ -25,6 +29,274 @@
 #define SSTVENC_OSC_PHASE_FRAC_SCALE                                         \
 	((double)(1 << SSTVENC_OSC_PHASE_FRAC_BITS))
 
+/*!
+ * One full cycle (2π radians) in fixed-point.  The phase wraps back to zero
+ * when it reaches this value.
+ */
+#define SSTVENC_OSC_PHASE_PERIOD                                             \
+	((uint32_t)(2 * M_PI * SSTVENC_OSC_PHASE_FRAC_SCALE))
+
+/*!
+ * Number of fractional phase bits discarded to form a look-up table index.
+ * This gives us 2^(29-20) = 512 table entries per radian.
+ */
+#define SSTVENC_OSC_LUT_SHIFT	    (20)
+
+/*!
+ * Number of entries in the look-up table: one full cycle
+ * (@ref SSTVENC_OSC_PHASE_PERIOD >> @ref SSTVENC_OSC_LUT_SHIFT, rounded up)
+ * plus a guard entry so the interpolation never has to wrap.
+ */
+#define SSTVENC_OSC_LUT_SZ	    (3219)
+
+/*!
+ * Mask for the fractional part of the look-up table index.
+ */
+#define SSTVENC_OSC_LUT_FRAC_MASK   ((1u << SSTVENC_OSC_LUT_SHIFT) - 1)
+
+/*!
+ * Number of samples the polynomial kernel reduces at a time before handing
+ * them to the @ref vecmath kernels.
+ */
+#define SSTVENC_OSC_POLY_BLOCK_SZ   (64)
+
+/*!
+ * Sine look-up table, shared by all oscillators using
+ * @ref SSTVENC_OSC_KERNEL_LUT.
+ */
+static double	      sstvenc_osc_lut[SSTVENC_OSC_LUT_SZ];
+
+/*!
+ * Guard for one-time initialisation of @ref sstvenc_osc_lut.
+ */
+static pthread_once_t sstvenc_osc_lut_once = PTHREAD_ONCE_INIT;
+
+/*!
+ * Fill the sine look-up table.
+ */
+static void sstvenc_osc_lut_init(void) {
+	for (uint32_t i = 0; i < SSTVENC_OSC_LUT_SZ; i++) {
+		sstvenc_osc_lut[i]
+		    = sin(((double)(((uint64_t)i) << SSTVENC_OSC_LUT_SHIFT))
+			  / SSTVENC_OSC_PHASE_FRAC_SCALE);
+	}
+}
+
+/*!
+ * Advance the fixed-point phase by the given increment, modulo 2π.  This
+ * avoids overflowing 32 bits when the increment is large.
+ */
+static inline uint32_t sstvenc_osc_phase_add(uint32_t phase, uint32_t inc) {
+	if (phase >= (SSTVENC_OSC_PHASE_PERIOD - inc)) {
+		return phase - (SSTVENC_OSC_PHASE_PERIOD - inc);
+	} else {
+		return phase + inc;
+	}
+}
+
+/*!
+ * Convert a phase offset in radians to fixed-point, modulo 2π.
+ */
+static uint32_t sstvenc_osc_fp_offset(double offset) {
+	if (offset == 0.0) {
+		return 0;
+	}
+
+	offset = fmod(offset, 2 * M_PI);
+	if (offset < 0.0) {
+		offset += 2 * M_PI;
+	}
+
+	uint32_t fp_offset
+	    = (uint32_t)(offset * SSTVENC_OSC_PHASE_FRAC_SCALE);
+	if (fp_offset >= SSTVENC_OSC_PHASE_PERIOD) {
+		fp_offset -= SSTVENC_OSC_PHASE_PERIOD;
+	}
+	return fp_offset;
+}
+
+/*!
+ * Interpolated table look-up of the sine of a fixed-point phase.
+ */
+static inline double sstvenc_osc_lut_sin(uint32_t phase) {
+	const uint32_t idx  = phase >> SSTVENC_OSC_LUT_SHIFT;
+	const double   frac = ((double)(phase & SSTVENC_OSC_LUT_FRAC_MASK))
+			    / ((double)(1u << SSTVENC_OSC_LUT_SHIFT));
+	const double   y0   = sstvenc_osc_lut[idx];
+
+	return y0 + (frac * (sstvenc_osc_lut[idx + 1] - y0));
+}
+
+/*!
+ * Reduce a fixed-point phase plus a phase offset in radians to the range
+ * [-π/2, π/2] for the polynomial kernel, taking advantage of the symmetry of
+ * the sine function.  The offset is applied in floating point so it is not
+ * quantised.
+ */
+static inline double sstvenc_osc_poly_arg(uint32_t phase, double offset) {
+	double x = ((double)phase) / SSTVENC_OSC_PHASE_FRAC_SCALE;
+
+	if (offset != 0.0) {
+		x += offset;
+		x -= 2 * M_PI * floor(x / (2 * M_PI));
+	}
+
+	/* Reduce to [-π, π] then fold into [-π/2, π/2] */
+	if (x > M_PI) {
+		x -= 2 * M_PI;
+	}
+
+	if (x > M_PI_2) {
+		x = M_PI - x;
+	} else if (x < -M_PI_2) {
+		x = -M_PI - x;
+	}
+
+	return x;
+}
+
+/*!
+ * Re-synchronise the phasor with the given fixed-point phase.
+ */
+static void sstvenc_osc_phasor_resync(struct sstvenc_oscillator* const osc,
+				      uint32_t phase) {
+	const double angle
+	    = osc->offset + (((double)phase) / SSTVENC_OSC_PHASE_FRAC_SCALE);
+
+	osc->phasor[0]	 = cos(angle);
+	osc->phasor[1]	 = sin(angle);
+	osc->phasor_left = SSTVENC_OSC_PHASOR_RESYNC;
+}
+
+/*!
+ * Compute the per-sample phasor rotation from the phase increment and force
+ * a re-synchronisation on the next sample.
+ */
+static void sstvenc_osc_phasor_setup(struct sstvenc_oscillator* const osc) {
+	const double step
+	    = ((double)osc->phase_inc) / SSTVENC_OSC_PHASE_FRAC_SCALE;
+
+	osc->rotation[0] = cos(step);
+	osc->rotation[1] = sin(step);
+	osc->phasor_left = 0;
+}
+
+/*!
+ * Render a block of samples.  The kernel is chosen once for the whole block
+ * and the phase is kept in a local so the inner loops stay tight.
+ *
+ * @param[inout]	osc		Oscillator context.
+ * @param[in]		envelope	Per-sample amplitude, only read if
+ * 					@a use_env is true.
+ * @param[out]		buffer		Output samples.
+ * @param[in]		buffer_sz	Number of samples to render, at
+ * 					least 1.
+ * @param[in]		use_env		Use @a envelope rather than
+ * 					sstvenc_oscillator#amplitude.
+ */
+static inline void sstvenc_osc_render(struct sstvenc_oscillator* const osc,
+				      const double* envelope, double* buffer,
+				      size_t buffer_sz, _Bool use_env) {
+	const double   amplitude = osc->amplitude;
+	const double   offset	 = osc->offset;
+	const uint32_t phase_inc = osc->phase_inc;
+	uint32_t       phase	 = osc->phase;
+	size_t	       i;
+
+	/* Grab this now, the caller may be rendering in-place */
+	const double   last_env	 = use_env ? envelope[buffer_sz - 1] : 0.0;
+
+	switch (osc->kernel) {
+	case SSTVENC_OSC_KERNEL_LUT: {
+		const uint32_t fp_offset = sstvenc_osc_fp_offset(offset);
+
+		for (i = 0; i < buffer_sz; i++) {
+			const double   a = use_env ? envelope[i] : amplitude;
+			const uint32_t p
+			    = sstvenc_osc_phase_add(phase, fp_offset);
+
+			buffer[i] = a * sstvenc_osc_lut_sin(p);
+			phase	  = sstvenc_osc_phase_add(phase, phase_inc);
+		}
+	} break;
+	case SSTVENC_OSC_KERNEL_PHASOR: {
+		const double rc = osc->rotation[0];
+		const double rs = osc->rotation[1];
+
+		for (i = 0; i < buffer_sz; i++) {
+			const double a = use_env ? envelope[i] : amplitude;
+
+			if (!osc->phasor_left) {
+				sstvenc_osc_phasor_resync(osc, phase);
+			}
+
+			const double re	 = osc->phasor[0];
+			const double im	 = osc->phasor[1];
+			const double nre = (re * rc) - (im * rs);
+			const double nim = (re * rs) + (im * rc);
+
+			/* First-order renormalisation, g ≈ 1/|z| */
+			const double g
+			    = 1.5 - (0.5 * ((nre * nre) + (nim * nim)));
+
+			osc->phasor[0] = nre * g;
+			osc->phasor[1] = nim * g;
+			osc->phasor_left--;
+
+			buffer[i] = a * im;
+			phase	  = sstvenc_osc_phase_add(phase, phase_inc);
+		}
+	} break;
+	case SSTVENC_OSC_KERNEL_POLY: {
+		const struct sstvenc_vec_ops* vec = sstvenc_vec_get_ops();
+
+		/*
+		 * Reduce the phase in scalar code, then hand the
+		 * polynomial evaluation to the vectorised kernels.
+		 */
+		for (i = 0; i < buffer_sz;) {
+			double x[SSTVENC_OSC_POLY_BLOCK_SZ];
+			size_t sz = buffer_sz - i;
+			if (sz > SSTVENC_OSC_POLY_BLOCK_SZ) {
+				sz = SSTVENC_OSC_POLY_BLOCK_SZ;
+			}
+
+			for (size_t j = 0; j < sz; j++) {
+				x[j]  = sstvenc_osc_poly_arg(phase, offset);
+				phase = sstvenc_osc_phase_add(phase,
+							      phase_inc);
+			}
+
+			if (use_env) {
+				vec->sin_env(buffer + i, x, envelope + i, sz);
+			} else {
+				vec->sin(buffer + i, x, amplitude, sz);
+			}
+
+			i += sz;
+		}
+	} break;
+	case SSTVENC_OSC_KERNEL_LIBM:
+	default:
+		for (i = 0; i < buffer_sz; i++) {
+			const double a = use_env ? envelope[i] : amplitude;
+			buffer[i]
+			    = a
+			      * sin(offset
+				    + (((double)phase)
+				       / SSTVENC_OSC_PHASE_FRAC_SCALE));
+			phase = sstvenc_osc_phase_add(phase, phase_inc);
+		}
+		break;
+	}
+
+	osc->phase  = phase;
+	osc->output = buffer[buffer_sz - 1];
+	if (use_env) {
+		osc->amplitude = last_env;
+	}
+}
+
 double sstvenc_osc_get_frequency(const struct sstvenc_oscillator* const osc) {
 	return ((double)(((uint64_t)osc->phase_inc) * osc->sample_rate))
 	       / (2 * M_PI * SSTVENC_OSC_PHASE_FRAC_SCALE);
@@ -35,32 +307,81 @@ void sstvenc_osc_set_frequency(struct sstvenc_oscillator* const osc,
 	assert(frequency >= 0);
 	assert(frequency < (osc->sample_rate / 2));
 
-	osc->phase_inc = (2 * M_PI * frequency * SSTVENC_OSC_PHASE_FRAC_SCALE)
-			 / osc->sample_rate;
+	sstvenc_osc_set_phase_inc(
+	    osc, sstvenc_osc_freq_phase_inc(osc->sample_rate, frequency));
+}
+
+uint32_t sstvenc_osc_freq_phase_inc(uint32_t sample_rate, double frequency) {
+	return (2 * M_PI * frequency * SSTVENC_OSC_PHASE_FRAC_SCALE)
+	       / sample_rate;
+}
+
+void sstvenc_osc_set_phase_inc(struct sstvenc_oscillator* const osc,
+			       uint32_t				phase_inc) {
+	osc->phase_inc = phase_inc;
+
+	if (osc->kernel == SSTVENC_OSC_KERNEL_PHASOR) {
+		sstvenc_osc_phasor_setup(osc);
+	}
+}
+
+void sstvenc_osc_set_kernel(struct sstvenc_oscillator* const osc,
+			    uint8_t			     kernel) {
+	osc->kernel = kernel;
+
+	switch (kernel) {
+	case SSTVENC_OSC_KERNEL_LUT:
+		pthread_once(&sstvenc_osc_lut_once, sstvenc_osc_lut_init);
+		break;
+	case SSTVENC_OSC_KERNEL_PHASOR:
+		sstvenc_osc_phasor_setup(osc);
+		break;
+	default:
+		break;
+	}
 }
 
 void sstvenc_osc_init(struct sstvenc_oscillator* const osc, double amplitude,
-		      double frequency, double offset, uint32_t sample_rate) {
+		      double frequency, double offset, uint32_t sample_rate,
+		      uint8_t kernel) {
 	osc->amplitude	 = amplitude;
 	osc->offset	 = offset;
 	osc->output	 = 0.0;
 	osc->sample_rate = sample_rate;
 	osc->phase	 = 0;
+	osc->phasor_left = 0;
+	osc->kernel	 = SSTVENC_OSC_KERNEL_LIBM;
 	sstvenc_osc_set_frequency(osc, frequency);
+	sstvenc_osc_set_kernel(osc, kernel);
+}
+
+void sstvenc_osc_skip(struct sstvenc_oscillator* const osc,
+		      uint64_t			       samples) {
+	const uint64_t period  = SSTVENC_OSC_PHASE_PERIOD;
+	const uint64_t advance = (samples % period) * osc->phase_inc;
+
+	osc->phase	 = (uint32_t)((osc->phase + advance) % period);
+	osc->phasor_left = 0;
 }
 
 void sstvenc_osc_compute(struct sstvenc_oscillator* const osc) {
 	if (osc->sample_rate) {
-		/* Compute output */
-		osc->output = osc->amplitude
-			      * sin(osc->offset
-				    + (((double)osc->phase)
-				       / SSTVENC_OSC_PHASE_FRAC_SCALE));
+		sstvenc_osc_render(osc, NULL, &(osc->output), 1, false);
+	}
+}
+
+void sstvenc_osc_fill(struct sstvenc_oscillator* const osc, double* buffer,
+		      size_t buffer_sz) {
+	if (osc->sample_rate && buffer_sz) {
+		sstvenc_osc_render(osc, NULL, buffer, buffer_sz, false);
+	}
+}
 
-		/* Increment phase, modulo 2Pi */
-		osc->phase += osc->phase_inc;
-		osc->phase
-		    %= (uint32_t)(2 * M_PI * SSTVENC_OSC_PHASE_FRAC_SCALE);
+void sstvenc_osc_fill_env(struct sstvenc_oscillator* const osc,
+			  const double* envelope, double* buffer,
+			  size_t buffer_sz) {
+	if (osc->sample_rate && buffer_sz) {
+		sstvenc_osc_render(osc, envelope, buffer, buffer_sz, true);
 	}
 }
 
@@ -10,6 +10,141 @@
 
 #include <libsstvenc/oscillator.h>
 #include <libsstvenc/pulseshape.h>
+#include <libsstvenc/sampfmt.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+/*!
+ * A shared envelope table.
+ */
+struct sstvenc_ps_table {
+	/*! Normalised envelope values, `len + 2` entries */
+	const double* values;
+	/*! Ramp length in samples */
+	uint16_t      len;
+	/*! Ramp shape, see @ref pulseshape_shapes */
+	uint8_t	      shape;
+};
+
+/*!
+ * Storage for the envelope tables.
+ */
+static double		       sstvenc_ps_pool[SSTVENC_PS_TABLE_POOL_SZ];
+
+/*!
+ * Number of samples of @ref sstvenc_ps_pool in use.
+ */
+static size_t		       sstvenc_ps_pool_used;
+
+/*!
+ * Envelope tables built so far.
+ */
+static struct sstvenc_ps_table sstvenc_ps_tables[SSTVENC_PS_TABLE_MAX];
+
+/*!
+ * Number of entries in @ref sstvenc_ps_tables.
+ */
+static uint8_t		       sstvenc_ps_tables_sz;
+
+/*!
+ * Lock protecting the envelope table cache.
+ */
+static pthread_mutex_t	       sstvenc_ps_tables_lock
+    = PTHREAD_MUTEX_INITIALIZER;
+
+/*!
+ * Compute the normalised rising envelope for sample @a idx of a ramp @a len
+ * samples long, clipped to 1.0.
+ */
+static double sstvenc_ps_shape_value(uint8_t shape, uint32_t idx,
+				     uint16_t len) {
+	double value;
+
+	switch (shape) {
+	case SSTVENC_PS_SHAPE_HANN:
+		if (idx >= len) {
+			return 1.0;
+		}
+		value = 0.5 - (0.5 * cos((idx * M_PI) / ((double)len)));
+		break;
+	case SSTVENC_PS_SHAPE_BLACKMAN:
+		if (idx >= len) {
+			return 1.0;
+		}
+		value = 0.42 - (0.5 * cos((idx * M_PI) / ((double)len)))
+			+ (0.08 * cos((2 * idx * M_PI) / ((double)len)));
+		break;
+	case SSTVENC_PS_SHAPE_COSINE:
+	default:
+		value = 1.0 - cos((idx * M_PI) / (2 * ((double)len)));
+		break;
+	}
+
+	if (value > 1.0) {
+		value = 1.0;
+	} else if (value < 0.0) {
+		value = 0.0;
+	}
+
+	return value;
+}
+
+/*!
+ * Find or build the envelope table for the given ramp length and shape.
+ *
+ * @returns	Pointer to `len + 2` normalised envelope values, or NULL if
+ * 		the table does not fit in the pool.
+ */
+static const double* sstvenc_ps_get_table(uint16_t len, uint8_t shape) {
+	const double* values = NULL;
+
+	pthread_mutex_lock(&sstvenc_ps_tables_lock);
+
+	for (uint8_t i = 0; i < sstvenc_ps_tables_sz; i++) {
+		if ((sstvenc_ps_tables[i].len == len)
+		    && (sstvenc_ps_tables[i].shape == shape)) {
+			values = sstvenc_ps_tables[i].values;
+			goto out;
+		}
+	}
+
+	if ((sstvenc_ps_tables_sz < SSTVENC_PS_TABLE_MAX)
+	    && ((SSTVENC_PS_TABLE_POOL_SZ - sstvenc_ps_pool_used)
+		>= ((size_t)len + 2))) {
+		double* table
+		    = &(sstvenc_ps_pool[sstvenc_ps_pool_used]);
+
+		for (uint32_t idx = 0; idx < ((uint32_t)len + 2); idx++) {
+			table[idx] = sstvenc_ps_shape_value(shape, idx, len);
+		}
+
+		sstvenc_ps_tables[sstvenc_ps_tables_sz].values = table;
+		sstvenc_ps_tables[sstvenc_ps_tables_sz].len    = len;
+		sstvenc_ps_tables[sstvenc_ps_tables_sz].shape  = shape;
+		sstvenc_ps_tables_sz++;
+		sstvenc_ps_pool_used += (size_t)len + 2;
+		values = table;
+	}
+
+out:
+	pthread_mutex_unlock(&sstvenc_ps_tables_lock);
+	return values;
+}
+
+/*!
+ * Compute the envelope for sample @a idx of the rising ramp, or the falling
+ * ramp with @a idx samples remaining.
+ */
+static inline double
+sstvenc_ps_envelope(const struct sstvenc_pulseshape* const ps,
+		    const double* table, uint32_t idx, uint16_t len) {
+	if (table) {
+		return ps->amplitude * table[idx];
+	} else {
+		return ps->amplitude
+		       * sstvenc_ps_shape_value(ps->shape, idx, len);
+	}
+}
 
 void sstvenc_ps_reset_samples(struct sstvenc_pulseshape* const ps,
 			      uint32_t			       hold_time) {
@@ -50,9 +185,25 @@ void sstvenc_ps_init(struct sstvenc_pulseshape* const ps, double amplitude,
 		ps->fall_sz = samples;
 	}
 
+	sstvenc_ps_set_shape(ps, SSTVENC_PS_SHAPE_COSINE);
 	sstvenc_ps_reset(ps, hold_time, time_unit);
 }
 
+void sstvenc_ps_set_shape(struct sstvenc_pulseshape* const ps,
+			  uint8_t			   shape) {
+	ps->shape    = shape;
+	ps->rise_env = NULL;
+	ps->fall_env = NULL;
+
+	if (ps->rise_sz) {
+		ps->rise_env = sstvenc_ps_get_table(ps->rise_sz, shape);
+	}
+
+	if (ps->fall_sz) {
+		ps->fall_env = sstvenc_ps_get_table(ps->fall_sz, shape);
+	}
+}
+
 void sstvenc_ps_advance(struct sstvenc_pulseshape* const ps) {
 	if (ps->phase < SSTVENC_PS_PHASE_DONE) {
 		ps->sample_idx = 0;
@@ -69,14 +220,8 @@ void sstvenc_ps_compute(struct sstvenc_pulseshape* const ps) {
 		/* Fall-thru */
 	case SSTVENC_PS_PHASE_RISE:
 		if (ps->rise_sz) {
-			/* Compute the raised sine amplitude */
-			ps->output = ps->amplitude
-				     * (1.0
-					- cos((ps->sample_idx * M_PI)
-					      / (2 * ((double)ps->rise_sz))));
-			if (ps->output > ps->amplitude) {
-				ps->output = ps->amplitude;
-			}
+			ps->output = sstvenc_ps_envelope(
+			    ps, ps->rise_env, ps->sample_idx, ps->rise_sz);
 		}
 		if (ps->sample_idx > ps->rise_sz) {
 			/* Next phase */
@@ -93,16 +238,9 @@ void sstvenc_ps_compute(struct sstvenc_pulseshape* const ps) {
 		break;
 	case SSTVENC_PS_PHASE_FALL:
 		if (ps->fall_sz) {
-			/* Compute the raised sine amplitude */
-			ps->output
-			    = ps->amplitude
-			      * (1.0
-				 - cos(((ps->fall_sz - ps->sample_idx) * M_PI)
-				       / (2 * ((double)ps->fall_sz))));
-
-			if (ps->output > ps->amplitude) {
-				ps->output = ps->amplitude;
-			}
+			ps->output = sstvenc_ps_envelope(
+			    ps, ps->fall_env, ps->fall_sz - ps->sample_idx,
+			    ps->fall_sz);
 		}
 		if (ps->sample_idx >= ps->fall_sz) {
 			/* Next phase */
@@ -116,25 +254,161 @@ void sstvenc_ps_compute(struct sstvenc_pulseshape* const ps) {
 	}
 }
 
-size_t sstvenc_psosc_fill_buffer(struct sstvenc_pulseshape* const ps,
-				 struct sstvenc_oscillator* const osc,
-				 double* buffer, size_t buffer_sz) {
+/*!
+ * Render part of a rise or fall ramp into the buffer, advancing
+ * sstvenc_pulseshape#sample_idx by @a buffer_sz samples.
+ *
+ * @param[inout]	ps		Pulse shaper context.
+ * @param[out]		buffer		Buffer to write envelope samples to.
+ * @param[in]		buffer_sz	Number of samples to write, at
+ * 					least 1.
+ * @param[in]		table		Envelope table for the ramp, or NULL.
+ * @param[in]		ramp_sz		Length of the ramp in samples.
+ * @param[in]		falling		true for a falling ramp.
+ */
+static void sstvenc_ps_fill_ramp(struct sstvenc_pulseshape* const ps,
+				 double* buffer, size_t buffer_sz,
+				 const double* table, uint16_t ramp_sz,
+				 _Bool falling) {
+	for (size_t i = 0; i < buffer_sz; i++) {
+		uint32_t idx = ps->sample_idx + 1 + (uint32_t)i;
+		if (falling) {
+			idx = ramp_sz - idx;
+		}
+
+		buffer[i] = sstvenc_ps_envelope(ps, table, idx, ramp_sz);
+	}
+
+	ps->sample_idx += (uint32_t)buffer_sz;
+	ps->output	= buffer[buffer_sz - 1];
+}
+
+size_t sstvenc_ps_fill(struct sstvenc_pulseshape* const ps, double* buffer,
+		       size_t buffer_sz) {
 	size_t written_sz = 0;
 
-	while ((buffer_sz > 0) && (ps->phase < SSTVENC_PS_PHASE_DONE)) {
-		sstvenc_ps_compute(ps);
-		osc->amplitude = ps->output;
+	while ((written_sz < buffer_sz)
+	       && (ps->phase < SSTVENC_PS_PHASE_DONE)) {
+		if (ps->phase == SSTVENC_PS_PHASE_INIT) {
+			/* Nothing to do here but move to the rise phase */
+			ps->phase = SSTVENC_PS_PHASE_RISE;
+		}
+
+		if ((ps->phase == SSTVENC_PS_PHASE_RISE) && ps->rise_sz) {
+			/* We emit one extra sample, clipped to amplitude */
+			size_t run = (ps->rise_sz + 1) - ps->sample_idx;
+			if (run > (buffer_sz - written_sz)) {
+				run = buffer_sz - written_sz;
+			}
 
-		sstvenc_osc_compute(osc);
-		buffer[0] = osc->output;
+			sstvenc_ps_fill_ramp(ps, buffer + written_sz, run,
+					     ps->rise_env, ps->rise_sz,
+					     false);
+			written_sz += run;
 
-		buffer++;
-		buffer_sz--;
+			if (ps->sample_idx > ps->rise_sz) {
+				/* Next phase */
+				sstvenc_ps_advance(ps);
+			}
+		} else if ((ps->phase == SSTVENC_PS_PHASE_FALL)
+			   && ps->fall_sz) {
+			size_t run = 1;
+			if (ps->sample_idx < ps->fall_sz) {
+				run = ps->fall_sz - ps->sample_idx;
+			}
+			if (run > (buffer_sz - written_sz)) {
+				run = buffer_sz - written_sz;
+			}
+
+			sstvenc_ps_fill_ramp(ps, buffer + written_sz, run,
+					     ps->fall_env, ps->fall_sz,
+					     true);
+			written_sz += run;
+
+			if (ps->sample_idx >= ps->fall_sz) {
+				/* Next phase */
+				sstvenc_ps_advance(ps);
+			}
+		} else if (ps->phase == SSTVENC_PS_PHASE_HOLD) {
+			/*
+			 * Constant amplitude, figure out how many samples
+			 * are left in the hold phase and emit them in one go.
+			 */
+			size_t run = buffer_sz - written_sz;
 
-		written_sz++;
+			if (ps->hold_sz != SSTVENC_PS_HOLD_TIME_INF) {
+				uint32_t left = 1;
+				if (ps->sample_idx < ps->hold_sz) {
+					left = ps->hold_sz - ps->sample_idx;
+				}
+
+				if (left < run) {
+					run = left;
+				}
+			}
+
+			for (size_t i = 0; i < run; i++) {
+				buffer[written_sz + i] = ps->amplitude;
+			}
+
+			ps->output	= ps->amplitude;
+			ps->sample_idx += (uint32_t)run;
+			written_sz     += run;
+
+			if ((ps->hold_sz != SSTVENC_PS_HOLD_TIME_INF)
+			    && (ps->sample_idx >= ps->hold_sz)) {
+				/* Next phase */
+				sstvenc_ps_advance(ps);
+			}
+		} else {
+			sstvenc_ps_compute(ps);
+			buffer[written_sz] = ps->output;
+			written_sz++;
+		}
 	}
 
 	return written_sz;
 }
 
+size_t sstvenc_psosc_fill_buffer(struct sstvenc_pulseshape* const ps,
+				 struct sstvenc_oscillator* const osc,
+				 double* buffer, size_t buffer_sz) {
+	/* Render the envelope, then modulate the oscillator with it */
+	size_t written_sz = sstvenc_ps_fill(ps, buffer, buffer_sz);
+	sstvenc_osc_fill_env(osc, buffer, buffer, written_sz);
+
+	return written_sz;
+}
+
+/*!
+ * Pulse shaper and oscillator pair, the context for
+ * @ref sstvenc_psosc_source.
+ */
+struct sstvenc_psosc {
+	/*! Pulse shaper providing the envelope */
+	struct sstvenc_pulseshape* ps;
+	/*! Oscillator being modulated */
+	struct sstvenc_oscillator* osc;
+};
+
+/*!
+ * Sample source for the narrow-format fill functions, see @ref sampfmt.
+ */
+static size_t sstvenc_psosc_source(void* ctx, double* buffer,
+				   size_t buffer_sz) {
+	struct sstvenc_psosc* const psosc = ctx;
+
+	return sstvenc_psosc_fill_buffer(psosc->ps, psosc->osc, buffer,
+					 buffer_sz);
+}
+
+size_t sstvenc_psosc_fill_buffer_f32(struct sstvenc_pulseshape* const ps,
+				     struct sstvenc_oscillator* const osc,
+				     float* buffer, size_t buffer_sz) {
+	struct sstvenc_psosc psosc = {.ps = ps, .osc = osc};
+
+	return sstvenc_sampfmt_fill_f32(buffer, buffer_sz,
+					sstvenc_psosc_source, &psosc);
+}
+
 /*! @} */
@@ -0,0 +1,249 @@
+/*!
+ * @addtogroup render
+ * @{
+ */
+
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <libsstvenc/render.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+/*!
+ * A band of samples rendered by one thread.
+ */
+struct sstvenc_render_band {
+	/*! Modulator, positioned at the start of the band */
+	struct sstvenc_mod mod;
+	/*! Where the band's samples are written */
+	double*		   buffer;
+	/*! Length of the band in samples */
+	size_t		   buffer_sz;
+	/*! Number of samples actually rendered */
+	size_t		   written_sz;
+	/*! Thread rendering the band */
+	pthread_t	   thread;
+	/*! Whether @ref sstvenc_render_band#thread was started */
+	bool		   started;
+};
+
+/*!
+ * Render a band of samples.  This is the thread entry point.
+ */
+static void* sstvenc_render_band_run(void* arg) {
+	struct sstvenc_render_band* const band = arg;
+
+	band->written_sz = sstvenc_modulator_fill_buffer(
+	    &(band->mod), band->buffer, band->buffer_sz);
+	return NULL;
+}
+
+size_t sstvenc_render_fill_buffer(struct sstvenc_mod* const mod,
+				  double* buffer, size_t buffer_sz,
+				  uint8_t threads) {
+	struct sstvenc_render_band bands[SSTVENC_RENDER_MAX_THREADS];
+	size_t			   band_sz;
+	size_t			   written_sz = 0;
+
+	if (threads > SSTVENC_RENDER_MAX_THREADS) {
+		threads = SSTVENC_RENDER_MAX_THREADS;
+	}
+
+	if (threads > (buffer_sz / SSTVENC_RENDER_MIN_BAND_SZ)) {
+		threads = buffer_sz / SSTVENC_RENDER_MIN_BAND_SZ;
+	}
+
+	if (threads < 2) {
+		return sstvenc_modulator_fill_buffer(mod, buffer, buffer_sz);
+	}
+
+	/*
+	 * Position a modulator at the start of each band.  The last band
+	 * picks up whatever is left over.
+	 */
+	band_sz = buffer_sz / threads;
+	for (uint8_t i = 0; i < threads; i++) {
+		bands[i].mod	    = *mod;
+		bands[i].buffer	    = buffer + (i * band_sz);
+		bands[i].buffer_sz  = band_sz;
+		bands[i].written_sz = 0;
+		bands[i].started    = false;
+
+		if (i == (threads - 1)) {
+			bands[i].buffer_sz = buffer_sz - (i * band_sz);
+		} else {
+			sstvenc_modulator_skip(mod, band_sz);
+		}
+	}
+
+	/* The first band is rendered by this thread */
+	for (uint8_t i = 1; i < threads; i++) {
+		bands[i].started
+		    = (pthread_create(&(bands[i].thread), NULL,
+				      sstvenc_render_band_run, &(bands[i]))
+		       == 0);
+	}
+
+	sstvenc_render_band_run(&(bands[0]));
+
+	for (uint8_t i = 1; i < threads; i++) {
+		if (bands[i].started) {
+			pthread_join(bands[i].thread, NULL);
+		} else {
+			sstvenc_render_band_run(&(bands[i]));
+		}
+	}
+
+	/*
+	 * The bands follow on from each other, and only the band in which
+	 * the transmission ends can come up short.
+	 */
+	for (uint8_t i = 0; i < threads; i++) {
+		written_sz += bands[i].written_sz;
+	}
+
+	*mod = bands[threads - 1].mod;
+	return written_sz;
+}
+
+/*!
+ * Shared state of a batch render.
+ */
+struct sstvenc_render_batch {
+	/*! Jobs to render */
+	struct sstvenc_render_job* jobs;
+	/*! Number of jobs */
+	size_t			   jobs_sz;
+	/*! Index of the next job not yet taken by a thread */
+	size_t			   next_job;
+	/*! Guards @ref sstvenc_render_batch#next_job */
+	pthread_mutex_t		   lock;
+};
+
+/*!
+ * Read the monotonic clock in nanoseconds.
+ */
+static uint64_t sstvenc_render_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*!
+ * Render a single batch job to its sink.
+ */
+static void sstvenc_render_job_run(struct sstvenc_render_job* const job) {
+	struct sstvenc_mod mod;
+	double		   buffer[SSTVENC_RENDER_BLOCK_SZ];
+	uint64_t	   start_ns = sstvenc_render_now_ns();
+	size_t		   written_sz;
+
+	job->samples = 0;
+	job->result  = 0;
+
+	sstvenc_modulator_init_plan(&mod, job->plan, job->fsk_id,
+				    job->framebuffer, job->rise_time,
+				    job->fall_time, job->time_unit,
+				    job->kernel);
+
+	do {
+		written_sz = sstvenc_modulator_fill_buffer(
+		    &mod, buffer, SSTVENC_RENDER_BLOCK_SZ);
+		if (written_sz) {
+			job->result
+			    = job->sink(job->sink_ctx, buffer, written_sz);
+			job->samples += written_sz;
+		}
+	} while ((written_sz == SSTVENC_RENDER_BLOCK_SZ) && !job->result);
+
+	job->elapsed_ns = sstvenc_render_now_ns() - start_ns;
+}
+
+/*!
+ * Take jobs from the batch until none are left.  This is the thread entry
+ * point.
+ */
+static void* sstvenc_render_batch_run(void* arg) {
+	struct sstvenc_render_batch* const batch = arg;
+
+	while (1) {
+		size_t job;
+
+		pthread_mutex_lock(&(batch->lock));
+		job = batch->next_job;
+		if (job < batch->jobs_sz) {
+			batch->next_job++;
+		}
+		pthread_mutex_unlock(&(batch->lock));
+
+		if (job >= batch->jobs_sz) {
+			return NULL;
+		}
+
+		sstvenc_render_job_run(&(batch->jobs[job]));
+	}
+}
+
+int sstvenc_render_batch(struct sstvenc_render_job* jobs, size_t jobs_sz,
+			 uint8_t threads) {
+	struct sstvenc_render_batch batch;
+	pthread_t		    thread[SSTVENC_RENDER_MAX_THREADS];
+	bool			    started[SSTVENC_RENDER_MAX_THREADS];
+
+	if (!threads) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if (cpus > SSTVENC_RENDER_MAX_THREADS) {
+			threads = SSTVENC_RENDER_MAX_THREADS;
+		} else if (cpus > 0) {
+			threads = cpus;
+		} else {
+			threads = 1;
+		}
+	} else if (threads > SSTVENC_RENDER_MAX_THREADS) {
+		threads = SSTVENC_RENDER_MAX_THREADS;
+	}
+
+	/* No point starting threads that would find nothing to do */
+	if (threads > jobs_sz) {
+		threads = jobs_sz;
+	}
+
+	batch.jobs     = jobs;
+	batch.jobs_sz  = jobs_sz;
+	batch.next_job = 0;
+	pthread_mutex_init(&(batch.lock), NULL);
+
+	/* This thread is the first worker */
+	for (uint8_t i = 1; i < threads; i++) {
+		started[i] = (pthread_create(&(thread[i]), NULL,
+					     sstvenc_render_batch_run, &batch)
+			      == 0);
+	}
+
+	sstvenc_render_batch_run(&batch);
+
+	for (uint8_t i = 1; i < threads; i++) {
+		if (started[i]) {
+			pthread_join(thread[i], NULL);
+		}
+	}
+
+	pthread_mutex_destroy(&(batch.lock));
+
+	for (size_t i = 0; i < jobs_sz; i++) {
+		if (jobs[i].result < 0) {
+			return jobs[i].result;
+		}
+	}
+
+	return 0;
+}
+
+/*! @} */
@@ -0,0 +1,1179 @@
+/*!
+ * @addtogroup sampfmt
+ * @{
+ */
+
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <libsstvenc/cpu.h>
+#include <libsstvenc/sampfmt.h>
+#include <pthread.h>
+#include <string.h>
+
+#ifdef MISSING_ENDIAN_H
+#include <arpa/inet.h>
+static uint16_t be16toh(uint16_t in) { return ntohs(in); }
+static uint16_t htobe16(uint16_t in) { return htons(in); }
+
+static uint32_t be32toh(uint32_t in) { return ntohl(in); }
+static uint32_t htobe32(uint32_t in) { return htonl(in); }
+
+static uint64_t be64toh(uint64_t in) {
+	return ((uint64_t)((((uint64_t)ntohl(in >> 32)) << 32)
+			   | ntohl(in & UINT32_MAX)));
+}
+static uint64_t htobe64(uint64_t in) {
+	return ((uint64_t)((((uint64_t)htonl(in >> 32)) << 32)
+			   | htonl(in & UINT32_MAX)));
+}
+#else
+#include <endian.h>
+#endif
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)                            \
+    && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#include <arm_neon.h>
+/*! NEON kernels are built; they assume a little-endian host. */
+#define SSTVENC_SAMPFMT_NEON
+#endif
+
+/*!
+ * Kernel implementations for a given instruction set.
+ */
+struct sstvenc_sampfmt_ops {
+	/*! Implementation of @ref sstvenc_sampfmt_f64_to_s8 */
+	void (*f64_to_s8)(int8_t* out, const double* in, size_t sz);
+	/*! Implementation of @ref sstvenc_sampfmt_f64_to_s16 */
+	void (*f64_to_s16)(int16_t* out, const double* in, size_t sz,
+			   uint8_t endianness);
+	/*! Implementation of @ref sstvenc_sampfmt_f64_to_s32 */
+	void (*f64_to_s32)(int32_t* out, const double* in, size_t sz,
+			   uint8_t endianness);
+	/*! Implementation of @ref sstvenc_sampfmt_f64_to_f32 */
+	void (*f64_to_f32)(float* out, const double* in, size_t sz);
+	/*! Implementation of @ref sstvenc_sampfmt_f64_to_f32be */
+	void (*f64_to_f32be)(uint32_t* out, const double* in, size_t sz);
+	/*! Implementation of @ref sstvenc_sampfmt_f64_to_f64be */
+	void (*f64_to_f64be)(uint64_t* out, const double* in, size_t sz);
+	/*! Implementation of @ref sstvenc_sampfmt_s8_to_f64 */
+	void (*s8_to_f64)(double* out, const int8_t* in, size_t sz);
+	/*! Implementation of @ref sstvenc_sampfmt_s16_to_f64 */
+	void (*s16_to_f64)(double* out, const int16_t* in, size_t sz,
+			   uint8_t endianness);
+	/*! Implementation of @ref sstvenc_sampfmt_s32_to_f64 */
+	void (*s32_to_f64)(double* out, const int32_t* in, size_t sz,
+			   uint8_t endianness);
+	/*! Implementation of @ref sstvenc_sampfmt_f32be_to_f64 */
+	void (*f32be_to_f64)(double* out, const uint32_t* in, size_t sz);
+	/*! Implementation of @ref sstvenc_sampfmt_f64be_to_f64 */
+	void (*f64be_to_f64)(double* out, const uint64_t* in, size_t sz);
+};
+
+/*!
+ * Clip a sample to the range [-1.0, 1.0].
+ */
+static inline double sstvenc_sampfmt_clip(double sample) {
+	if (sample > 1.0) {
+		return 1.0;
+	} else if (sample < -1.0) {
+		return -1.0;
+	} else {
+		return sample;
+	}
+}
+
+static void sstvenc_sampfmt_f64_to_s8_scalar(int8_t* out, const double* in,
+					     size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		out[i] = INT8_MAX * sstvenc_sampfmt_clip(in[i]);
+	}
+}
+
+static void sstvenc_sampfmt_f64_to_s16_scalar(int16_t* out, const double* in,
+					      size_t sz, uint8_t endianness) {
+	for (size_t i = 0; i < sz; i++) {
+		out[i] = INT16_MAX * sstvenc_sampfmt_clip(in[i]);
+	}
+
+	if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+		for (size_t i = 0; i < sz; i++) {
+			/* Byte swap */
+			out[i] = htobe16(out[i]);
+		}
+	}
+}
+
+static void sstvenc_sampfmt_f64_to_s32_scalar(int32_t* out, const double* in,
+					      size_t sz, uint8_t endianness) {
+	for (size_t i = 0; i < sz; i++) {
+		out[i] = INT32_MAX * sstvenc_sampfmt_clip(in[i]);
+	}
+
+	if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+		for (size_t i = 0; i < sz; i++) {
+			/* Byte swap */
+			out[i] = htobe32(out[i]);
+		}
+	}
+}
+
+static void sstvenc_sampfmt_f64_to_f32_scalar(float* out, const double* in,
+					      size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		out[i] = (float)in[i];
+	}
+}
+
+static void sstvenc_sampfmt_f64_to_f32be_scalar(uint32_t* out,
+						const double* in, size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		float	 f = (float)in[i];
+		uint32_t ui;
+
+		memcpy(&ui, &f, sizeof(ui));
+		out[i] = htobe32(ui);
+	}
+}
+
+static void sstvenc_sampfmt_f64_to_f64be_scalar(uint64_t* out,
+						const double* in, size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		uint64_t ui;
+
+		memcpy(&ui, &in[i], sizeof(ui));
+		out[i] = htobe64(ui);
+	}
+}
+
+static void sstvenc_sampfmt_s8_to_f64_scalar(double* out, const int8_t* in,
+					     size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		out[i] = -(double)in[i] / (double)INT8_MIN;
+	}
+}
+
+static void sstvenc_sampfmt_s16_to_f64_scalar(double* out, const int16_t* in,
+					      size_t sz, uint8_t endianness) {
+	for (size_t i = 0; i < sz; i++) {
+		int16_t host_endian = in[i];
+
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			host_endian = be16toh(host_endian);
+		}
+
+		out[i] = -(double)host_endian / (double)INT16_MIN;
+	}
+}
+
+static void sstvenc_sampfmt_s32_to_f64_scalar(double* out, const int32_t* in,
+					      size_t sz, uint8_t endianness) {
+	for (size_t i = 0; i < sz; i++) {
+		int32_t host_endian = in[i];
+
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			host_endian = be32toh(host_endian);
+		}
+
+		out[i] = -(double)host_endian / (double)INT32_MIN;
+	}
+}
+
+static void
+sstvenc_sampfmt_f32be_to_f64_scalar(double* out, const uint32_t* in,
+				    size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		uint32_t ui = be32toh(in[i]);
+		float	 f;
+
+		memcpy(&f, &ui, sizeof(f));
+		out[i] = f;
+	}
+}
+
+static void
+sstvenc_sampfmt_f64be_to_f64_scalar(double* out, const uint64_t* in,
+				    size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		uint64_t ui = be64toh(in[i]);
+
+		memcpy(&out[i], &ui, sizeof(ui));
+	}
+}
+
+/*!
+ * Portable scalar kernels.
+ */
+static const struct sstvenc_sampfmt_ops sstvenc_sampfmt_ops_scalar = {
+    .f64_to_s8	  = sstvenc_sampfmt_f64_to_s8_scalar,
+    .f64_to_s16	  = sstvenc_sampfmt_f64_to_s16_scalar,
+    .f64_to_s32	  = sstvenc_sampfmt_f64_to_s32_scalar,
+    .f64_to_f32	  = sstvenc_sampfmt_f64_to_f32_scalar,
+    .f64_to_f32be = sstvenc_sampfmt_f64_to_f32be_scalar,
+    .f64_to_f64be = sstvenc_sampfmt_f64_to_f64be_scalar,
+    .s8_to_f64	  = sstvenc_sampfmt_s8_to_f64_scalar,
+    .s16_to_f64	  = sstvenc_sampfmt_s16_to_f64_scalar,
+    .s32_to_f64	  = sstvenc_sampfmt_s32_to_f64_scalar,
+    .f32be_to_f64 = sstvenc_sampfmt_f32be_to_f64_scalar,
+    .f64be_to_f64 = sstvenc_sampfmt_f64be_to_f64_scalar,
+};
+
+#if defined(__x86_64__)
+/*!
+ * SSE2 byte swap of each 16-bit element.
+ */
+static inline __m128i sstvenc_sampfmt_bswap16_sse2(__m128i v) {
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/*!
+ * SSE2 byte swap of each 32-bit element: swap the 16-bit halves, then the
+ * bytes within them.
+ */
+static inline __m128i sstvenc_sampfmt_bswap32_sse2(__m128i v) {
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return sstvenc_sampfmt_bswap16_sse2(v);
+}
+
+/*!
+ * SSE2 byte swap of each 64-bit element.
+ */
+static inline __m128i sstvenc_sampfmt_bswap64_sse2(__m128i v) {
+	v = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return sstvenc_sampfmt_bswap32_sse2(v);
+}
+
+/*!
+ * SSE2 clip, scale and truncate of four samples to 32-bit integers.
+ */
+static inline __m128i sstvenc_sampfmt_scale_sse2(const double* in,
+						 __m128d      scale) {
+	const __m128d lo  = _mm_set1_pd(-1.0);
+	const __m128d hi  = _mm_set1_pd(1.0);
+	const __m128d in0 = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(in), lo), hi);
+	const __m128d in1
+	    = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(in + 2), lo), hi);
+
+	return _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(in0, scale)),
+				  _mm_cvttpd_epi32(_mm_mul_pd(in1, scale)));
+}
+
+/*!
+ * SSE2 conversion of four 32-bit integers to scaled double-precision.
+ */
+static inline void sstvenc_sampfmt_widen_sse2(double* out, __m128i v,
+					      __m128d scale) {
+	const __m128i hi = _mm_srli_si128(v, 8);
+
+	_mm_storeu_pd(out, _mm_mul_pd(_mm_cvtepi32_pd(v), scale));
+	_mm_storeu_pd(out + 2, _mm_mul_pd(_mm_cvtepi32_pd(hi), scale));
+}
+
+static void sstvenc_sampfmt_f64_to_s8_sse2(int8_t* out, const double* in,
+					   size_t sz) {
+	const __m128d scale = _mm_set1_pd(INT8_MAX);
+	size_t	      i	    = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		const __m128i w = _mm_packs_epi32(
+		    sstvenc_sampfmt_scale_sse2(in + i, scale),
+		    sstvenc_sampfmt_scale_sse2(in + i + 4, scale));
+		_mm_storel_epi64((__m128i*)(out + i), _mm_packs_epi16(w, w));
+	}
+
+	sstvenc_sampfmt_f64_to_s8_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_f64_to_s16_sse2(int16_t* out, const double* in,
+					    size_t sz, uint8_t endianness) {
+	const __m128d scale = _mm_set1_pd(INT16_MAX);
+	size_t	      i	    = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		__m128i w = _mm_packs_epi32(
+		    sstvenc_sampfmt_scale_sse2(in + i, scale),
+		    sstvenc_sampfmt_scale_sse2(in + i + 4, scale));
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			w = sstvenc_sampfmt_bswap16_sse2(w);
+		}
+		_mm_storeu_si128((__m128i*)(out + i), w);
+	}
+
+	sstvenc_sampfmt_f64_to_s16_scalar(out + i, in + i, sz - i,
+					  endianness);
+}
+
+static void sstvenc_sampfmt_f64_to_s32_sse2(int32_t* out, const double* in,
+					    size_t sz, uint8_t endianness) {
+	const __m128d scale = _mm_set1_pd(INT32_MAX);
+	size_t	      i	    = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		__m128i v = sstvenc_sampfmt_scale_sse2(in + i, scale);
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			v = sstvenc_sampfmt_bswap32_sse2(v);
+		}
+		_mm_storeu_si128((__m128i*)(out + i), v);
+	}
+
+	sstvenc_sampfmt_f64_to_s32_scalar(out + i, in + i, sz - i,
+					  endianness);
+}
+
+/*!
+ * SSE2 conversion of four samples to single-precision.
+ */
+static inline __m128 sstvenc_sampfmt_narrow_sse2(const double* in) {
+	return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(in)),
+			     _mm_cvtpd_ps(_mm_loadu_pd(in + 2)));
+}
+
+static void sstvenc_sampfmt_f64_to_f32_sse2(float* out, const double* in,
+					    size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		_mm_storeu_ps(out + i, sstvenc_sampfmt_narrow_sse2(in + i));
+	}
+
+	sstvenc_sampfmt_f64_to_f32_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_f64_to_f32be_sse2(uint32_t* out, const double* in,
+					      size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		const __m128i v = _mm_castps_si128(
+		    sstvenc_sampfmt_narrow_sse2(in + i));
+		_mm_storeu_si128((__m128i*)(out + i),
+				 sstvenc_sampfmt_bswap32_sse2(v));
+	}
+
+	sstvenc_sampfmt_f64_to_f32be_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_f64_to_f64be_sse2(uint64_t* out, const double* in,
+					      size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 2) <= sz; i += 2) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		_mm_storeu_si128((__m128i*)(out + i),
+				 sstvenc_sampfmt_bswap64_sse2(v));
+	}
+
+	sstvenc_sampfmt_f64_to_f64be_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_s8_to_f64_sse2(double* out, const int8_t* in,
+					   size_t sz) {
+	const __m128d scale = _mm_set1_pd(-1.0 / INT8_MIN);
+	size_t	      i	    = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		/* Sign-extend by unpacking into the top byte and shifting */
+		const __m128i b = _mm_loadl_epi64((const __m128i*)(in + i));
+		const __m128i w = _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8);
+
+		sstvenc_sampfmt_widen_sse2(
+		    out + i, _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16),
+		    scale);
+		sstvenc_sampfmt_widen_sse2(
+		    out + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16),
+		    scale);
+	}
+
+	sstvenc_sampfmt_s8_to_f64_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_s16_to_f64_sse2(double* out, const int16_t* in,
+					    size_t sz, uint8_t endianness) {
+	const __m128d scale = _mm_set1_pd(-1.0 / INT16_MIN);
+	size_t	      i	    = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		__m128i w = _mm_loadu_si128((const __m128i*)(in + i));
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			w = sstvenc_sampfmt_bswap16_sse2(w);
+		}
+
+		sstvenc_sampfmt_widen_sse2(
+		    out + i, _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16),
+		    scale);
+		sstvenc_sampfmt_widen_sse2(
+		    out + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16),
+		    scale);
+	}
+
+	sstvenc_sampfmt_s16_to_f64_scalar(out + i, in + i, sz - i,
+					  endianness);
+}
+
+static void sstvenc_sampfmt_s32_to_f64_sse2(double* out, const int32_t* in,
+					    size_t sz, uint8_t endianness) {
+	const __m128d scale = _mm_set1_pd(-1.0 / INT32_MIN);
+	size_t	      i	    = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			v = sstvenc_sampfmt_bswap32_sse2(v);
+		}
+
+		sstvenc_sampfmt_widen_sse2(out + i, v, scale);
+	}
+
+	sstvenc_sampfmt_s32_to_f64_scalar(out + i, in + i, sz - i,
+					  endianness);
+}
+
+static void sstvenc_sampfmt_f32be_to_f64_sse2(double* out, const uint32_t* in,
+					      size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		const __m128i v = sstvenc_sampfmt_bswap32_sse2(
+		    _mm_loadu_si128((const __m128i*)(in + i)));
+		const __m128  f = _mm_castsi128_ps(v);
+
+		_mm_storeu_pd(out + i, _mm_cvtps_pd(f));
+		_mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+	}
+
+	sstvenc_sampfmt_f32be_to_f64_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_f64be_to_f64_sse2(double* out, const uint64_t* in,
+					      size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 2) <= sz; i += 2) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		_mm_storeu_si128((__m128i*)(out + i),
+				 sstvenc_sampfmt_bswap64_sse2(v));
+	}
+
+	sstvenc_sampfmt_f64be_to_f64_scalar(out + i, in + i, sz - i);
+}
+
+/*!
+ * SSE2 kernels.
+ */
+static const struct sstvenc_sampfmt_ops sstvenc_sampfmt_ops_sse2 = {
+    .f64_to_s8	  = sstvenc_sampfmt_f64_to_s8_sse2,
+    .f64_to_s16	  = sstvenc_sampfmt_f64_to_s16_sse2,
+    .f64_to_s32	  = sstvenc_sampfmt_f64_to_s32_sse2,
+    .f64_to_f32	  = sstvenc_sampfmt_f64_to_f32_sse2,
+    .f64_to_f32be = sstvenc_sampfmt_f64_to_f32be_sse2,
+    .f64_to_f64be = sstvenc_sampfmt_f64_to_f64be_sse2,
+    .s8_to_f64	  = sstvenc_sampfmt_s8_to_f64_sse2,
+    .s16_to_f64	  = sstvenc_sampfmt_s16_to_f64_sse2,
+    .s32_to_f64	  = sstvenc_sampfmt_s32_to_f64_sse2,
+    .f32be_to_f64 = sstvenc_sampfmt_f32be_to_f64_sse2,
+    .f64be_to_f64 = sstvenc_sampfmt_f64be_to_f64_sse2,
+};
+
+/*!
+ * AVX2 byte swap of each 32-bit element.
+ *
+ * As in @ref vecmath, the AVX2 kernels clear the upper halves of the YMM
+ * registers before handing the last few samples to the SSE2 kernels.
+ */
+__attribute__((target("avx2"))) static inline __m256i
+sstvenc_sampfmt_bswap32_avx2(__m256i v) {
+	const __m256i mask = _mm256_setr_epi8(
+	    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0,
+	    7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	return _mm256_shuffle_epi8(v, mask);
+}
+
+/*!
+ * AVX2 byte swap of each 64-bit element.
+ */
+__attribute__((target("avx2"))) static inline __m256i
+sstvenc_sampfmt_bswap64_avx2(__m256i v) {
+	const __m256i mask = _mm256_setr_epi8(
+	    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4,
+	    3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	return _mm256_shuffle_epi8(v, mask);
+}
+
+/*!
+ * AVX2 clip, scale and truncate of eight samples to 32-bit integers.
+ */
+__attribute__((target("avx2"))) static inline __m256i
+sstvenc_sampfmt_scale_avx2(const double* in, __m256d scale) {
+	const __m256d lo  = _mm256_set1_pd(-1.0);
+	const __m256d hi  = _mm256_set1_pd(1.0);
+	const __m256d in0 = _mm256_min_pd(
+	    _mm256_max_pd(_mm256_loadu_pd(in), lo), hi);
+	const __m256d in1 = _mm256_min_pd(
+	    _mm256_max_pd(_mm256_loadu_pd(in + 4), lo), hi);
+
+	return _mm256_setr_m128i(
+	    _mm256_cvttpd_epi32(_mm256_mul_pd(in0, scale)),
+	    _mm256_cvttpd_epi32(_mm256_mul_pd(in1, scale)));
+}
+
+/*!
+ * AVX2 conversion of eight 32-bit integers to scaled double-precision.
+ */
+__attribute__((target("avx2"))) static inline void
+sstvenc_sampfmt_widen_avx2(double* out, __m256i v, __m256d scale) {
+	_mm256_storeu_pd(
+	    out, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)),
+			       scale));
+	_mm256_storeu_pd(
+	    out + 4,
+	    _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)),
+			  scale));
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_f64_to_s8_avx2(int8_t* out, const double* in, size_t sz) {
+	const __m256d scale = _mm256_set1_pd(INT8_MAX);
+	size_t	      i	    = 0;
+
+	for (; (i + 16) <= sz; i += 16) {
+		const __m256i v0 = sstvenc_sampfmt_scale_avx2(in + i, scale);
+		const __m256i v1
+		    = sstvenc_sampfmt_scale_avx2(in + i + 8, scale);
+		/* Packing works within 128-bit lanes, so restore the order */
+		const __m256i w = _mm256_permute4x64_epi64(
+		    _mm256_packs_epi32(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+		const __m128i b
+		    = _mm_packs_epi16(_mm256_castsi256_si128(w),
+				      _mm256_extracti128_si256(w, 1));
+		_mm_storeu_si128((__m128i*)(out + i), b);
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_f64_to_s8_sse2(out + i, in + i, sz - i);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_f64_to_s16_avx2(int16_t* out, const double* in, size_t sz,
+				uint8_t endianness) {
+	const __m256d scale = _mm256_set1_pd(INT16_MAX);
+	const __m256i swap  = _mm256_setr_epi8(
+	    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2,
+	    5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	size_t	      i	    = 0;
+
+	for (; (i + 16) <= sz; i += 16) {
+		const __m256i v0 = sstvenc_sampfmt_scale_avx2(in + i, scale);
+		const __m256i v1
+		    = sstvenc_sampfmt_scale_avx2(in + i + 8, scale);
+		/* Packing works within 128-bit lanes, so restore the order */
+		__m256i w = _mm256_permute4x64_epi64(
+		    _mm256_packs_epi32(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			w = _mm256_shuffle_epi8(w, swap);
+		}
+		_mm256_storeu_si256((__m256i*)(out + i), w);
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_f64_to_s16_sse2(out + i, in + i, sz - i, endianness);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_f64_to_s32_avx2(int32_t* out, const double* in, size_t sz,
+				uint8_t endianness) {
+	const __m256d scale = _mm256_set1_pd(INT32_MAX);
+	size_t	      i	    = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		__m256i v = sstvenc_sampfmt_scale_avx2(in + i, scale);
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			v = sstvenc_sampfmt_bswap32_avx2(v);
+		}
+		_mm256_storeu_si256((__m256i*)(out + i), v);
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_f64_to_s32_sse2(out + i, in + i, sz - i, endianness);
+}
+
+/*!
+ * AVX2 conversion of eight samples to single-precision.
+ */
+__attribute__((target("avx2"))) static inline __m256
+sstvenc_sampfmt_narrow_avx2(const double* in) {
+	return _mm256_setr_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(in)),
+				_mm256_cvtpd_ps(_mm256_loadu_pd(in + 4)));
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_f64_to_f32_avx2(float* out, const double* in, size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		_mm256_storeu_ps(out + i,
+				 sstvenc_sampfmt_narrow_avx2(in + i));
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_f64_to_f32_sse2(out + i, in + i, sz - i);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_f64_to_f32be_avx2(uint32_t* out, const double* in,
+				  size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		const __m256i v = _mm256_castps_si256(
+		    sstvenc_sampfmt_narrow_avx2(in + i));
+		_mm256_storeu_si256((__m256i*)(out + i),
+				    sstvenc_sampfmt_bswap32_avx2(v));
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_f64_to_f32be_sse2(out + i, in + i, sz - i);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_f64_to_f64be_avx2(uint64_t* out, const double* in,
+				  size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		const __m256i v
+		    = _mm256_loadu_si256((const __m256i*)(in + i));
+		_mm256_storeu_si256((__m256i*)(out + i),
+				    sstvenc_sampfmt_bswap64_avx2(v));
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_f64_to_f64be_sse2(out + i, in + i, sz - i);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_s8_to_f64_avx2(double* out, const int8_t* in, size_t sz) {
+	const __m256d scale = _mm256_set1_pd(-1.0 / INT8_MIN);
+	size_t	      i	    = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		const __m128i b = _mm_loadl_epi64((const __m128i*)(in + i));
+		sstvenc_sampfmt_widen_avx2(out + i, _mm256_cvtepi8_epi32(b),
+					   scale);
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_s8_to_f64_sse2(out + i, in + i, sz - i);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_s16_to_f64_avx2(double* out, const int16_t* in, size_t sz,
+				uint8_t endianness) {
+	const __m256d scale = _mm256_set1_pd(-1.0 / INT16_MIN);
+	size_t	      i	    = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		__m128i w = _mm_loadu_si128((const __m128i*)(in + i));
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			w = sstvenc_sampfmt_bswap16_sse2(w);
+		}
+		sstvenc_sampfmt_widen_avx2(out + i, _mm256_cvtepi16_epi32(w),
+					   scale);
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_s16_to_f64_sse2(out + i, in + i, sz - i, endianness);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_s32_to_f64_avx2(double* out, const int32_t* in, size_t sz,
+				uint8_t endianness) {
+	const __m256d scale = _mm256_set1_pd(-1.0 / INT32_MIN);
+	size_t	      i	    = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			v = sstvenc_sampfmt_bswap32_avx2(v);
+		}
+		sstvenc_sampfmt_widen_avx2(out + i, v, scale);
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_s32_to_f64_sse2(out + i, in + i, sz - i, endianness);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_f32be_to_f64_avx2(double* out, const uint32_t* in,
+				  size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		const __m256i v	 = sstvenc_sampfmt_bswap32_avx2(
+		    _mm256_loadu_si256((const __m256i*)(in + i)));
+		const __m256  f	 = _mm256_castsi256_ps(v);
+		const __m128  lo = _mm256_castps256_ps128(f);
+		const __m128  hi = _mm256_extractf128_ps(f, 1);
+
+		_mm256_storeu_pd(out + i, _mm256_cvtps_pd(lo));
+		_mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(hi));
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_f32be_to_f64_sse2(out + i, in + i, sz - i);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_sampfmt_f64be_to_f64_avx2(double* out, const uint64_t* in,
+				  size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		const __m256i v
+		    = _mm256_loadu_si256((const __m256i*)(in + i));
+		_mm256_storeu_si256((__m256i*)(out + i),
+				    sstvenc_sampfmt_bswap64_avx2(v));
+	}
+
+	_mm256_zeroupper();
+	sstvenc_sampfmt_f64be_to_f64_sse2(out + i, in + i, sz - i);
+}
+
+/*!
+ * AVX2 kernels.
+ */
+static const struct sstvenc_sampfmt_ops sstvenc_sampfmt_ops_avx2 = {
+    .f64_to_s8	  = sstvenc_sampfmt_f64_to_s8_avx2,
+    .f64_to_s16	  = sstvenc_sampfmt_f64_to_s16_avx2,
+    .f64_to_s32	  = sstvenc_sampfmt_f64_to_s32_avx2,
+    .f64_to_f32	  = sstvenc_sampfmt_f64_to_f32_avx2,
+    .f64_to_f32be = sstvenc_sampfmt_f64_to_f32be_avx2,
+    .f64_to_f64be = sstvenc_sampfmt_f64_to_f64be_avx2,
+    .s8_to_f64	  = sstvenc_sampfmt_s8_to_f64_avx2,
+    .s16_to_f64	  = sstvenc_sampfmt_s16_to_f64_avx2,
+    .s32_to_f64	  = sstvenc_sampfmt_s32_to_f64_avx2,
+    .f32be_to_f64 = sstvenc_sampfmt_f32be_to_f64_avx2,
+    .f64be_to_f64 = sstvenc_sampfmt_f64be_to_f64_avx2,
+};
+#endif
+
+#if defined(SSTVENC_SAMPFMT_NEON)
+/*!
+ * NEON clip, scale and truncate of four samples to 32-bit integers.
+ */
+static inline int32x4_t sstvenc_sampfmt_scale_neon(const double* in,
+						   float64x2_t	 scale) {
+	const float64x2_t lo  = vdupq_n_f64(-1.0);
+	const float64x2_t hi  = vdupq_n_f64(1.0);
+	const float64x2_t in0 = vminq_f64(vmaxq_f64(vld1q_f64(in), lo), hi);
+	const float64x2_t in1
+	    = vminq_f64(vmaxq_f64(vld1q_f64(in + 2), lo), hi);
+
+	return vcombine_s32(vmovn_s64(vcvtq_s64_f64(vmulq_f64(in0, scale))),
+			    vmovn_s64(vcvtq_s64_f64(vmulq_f64(in1, scale))));
+}
+
+/*!
+ * NEON conversion of four 32-bit integers to scaled double-precision.
+ */
+static inline void sstvenc_sampfmt_widen_neon(double* out, int32x4_t v,
+					      float64x2_t scale) {
+	vst1q_f64(out, vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(v))),
+				 scale));
+	vst1q_f64(out + 2,
+		  vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_high_s32(v))),
+			    scale));
+}
+
+static void sstvenc_sampfmt_f64_to_s8_neon(int8_t* out, const double* in,
+					   size_t sz) {
+	const float64x2_t scale = vdupq_n_f64(INT8_MAX);
+	size_t		  i	= 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		const int16x8_t w = vcombine_s16(
+		    vmovn_s32(sstvenc_sampfmt_scale_neon(in + i, scale)),
+		    vmovn_s32(sstvenc_sampfmt_scale_neon(in + i + 4, scale)));
+		vst1_s8(out + i, vmovn_s16(w));
+	}
+
+	sstvenc_sampfmt_f64_to_s8_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_f64_to_s16_neon(int16_t* out, const double* in,
+					    size_t sz, uint8_t endianness) {
+	const float64x2_t scale = vdupq_n_f64(INT16_MAX);
+	size_t		  i	= 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		int16x8_t w = vcombine_s16(
+		    vmovn_s32(sstvenc_sampfmt_scale_neon(in + i, scale)),
+		    vmovn_s32(sstvenc_sampfmt_scale_neon(in + i + 4, scale)));
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			w = vreinterpretq_s16_u8(
+			    vrev16q_u8(vreinterpretq_u8_s16(w)));
+		}
+		vst1q_s16(out + i, w);
+	}
+
+	sstvenc_sampfmt_f64_to_s16_scalar(out + i, in + i, sz - i,
+					  endianness);
+}
+
+static void sstvenc_sampfmt_f64_to_s32_neon(int32_t* out, const double* in,
+					    size_t sz, uint8_t endianness) {
+	const float64x2_t scale = vdupq_n_f64(INT32_MAX);
+	size_t		  i	= 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		int32x4_t v = sstvenc_sampfmt_scale_neon(in + i, scale);
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			v = vreinterpretq_s32_u8(
+			    vrev32q_u8(vreinterpretq_u8_s32(v)));
+		}
+		vst1q_s32(out + i, v);
+	}
+
+	sstvenc_sampfmt_f64_to_s32_scalar(out + i, in + i, sz - i,
+					  endianness);
+}
+
+/*!
+ * NEON conversion of four samples to single-precision.
+ */
+static inline float32x4_t sstvenc_sampfmt_narrow_neon(const double* in) {
+	return vcombine_f32(vcvt_f32_f64(vld1q_f64(in)),
+			    vcvt_f32_f64(vld1q_f64(in + 2)));
+}
+
+static void sstvenc_sampfmt_f64_to_f32_neon(float* out, const double* in,
+					    size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		vst1q_f32(out + i, sstvenc_sampfmt_narrow_neon(in + i));
+	}
+
+	sstvenc_sampfmt_f64_to_f32_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_f64_to_f32be_neon(uint32_t* out, const double* in,
+					      size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		const uint8x16_t v = vreinterpretq_u8_f32(
+		    sstvenc_sampfmt_narrow_neon(in + i));
+		vst1q_u32(out + i, vreinterpretq_u32_u8(vrev32q_u8(v)));
+	}
+
+	sstvenc_sampfmt_f64_to_f32be_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_f64_to_f64be_neon(uint64_t* out, const double* in,
+					      size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 2) <= sz; i += 2) {
+		const uint8x16_t v = vreinterpretq_u8_f64(vld1q_f64(in + i));
+		vst1q_u64(out + i, vreinterpretq_u64_u8(vrev64q_u8(v)));
+	}
+
+	sstvenc_sampfmt_f64_to_f64be_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_s8_to_f64_neon(double* out, const int8_t* in,
+					   size_t sz) {
+	const float64x2_t scale = vdupq_n_f64(-1.0 / INT8_MIN);
+	size_t		  i	= 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		const int16x8_t w = vmovl_s8(vld1_s8(in + i));
+
+		sstvenc_sampfmt_widen_neon(
+		    out + i, vmovl_s16(vget_low_s16(w)), scale);
+		sstvenc_sampfmt_widen_neon(
+		    out + i + 4, vmovl_s16(vget_high_s16(w)), scale);
+	}
+
+	sstvenc_sampfmt_s8_to_f64_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_s16_to_f64_neon(double* out, const int16_t* in,
+					    size_t sz, uint8_t endianness) {
+	const float64x2_t scale = vdupq_n_f64(-1.0 / INT16_MIN);
+	size_t		  i	= 0;
+
+	for (; (i + 8) <= sz; i += 8) {
+		int16x8_t w = vld1q_s16(in + i);
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			w = vreinterpretq_s16_u8(
+			    vrev16q_u8(vreinterpretq_u8_s16(w)));
+		}
+
+		sstvenc_sampfmt_widen_neon(
+		    out + i, vmovl_s16(vget_low_s16(w)), scale);
+		sstvenc_sampfmt_widen_neon(
+		    out + i + 4, vmovl_s16(vget_high_s16(w)), scale);
+	}
+
+	sstvenc_sampfmt_s16_to_f64_scalar(out + i, in + i, sz - i,
+					  endianness);
+}
+
+static void sstvenc_sampfmt_s32_to_f64_neon(double* out, const int32_t* in,
+					    size_t sz, uint8_t endianness) {
+	const float64x2_t scale = vdupq_n_f64(-1.0 / INT32_MIN);
+	size_t		  i	= 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		int32x4_t v = vld1q_s32(in + i);
+		if (endianness == SSTVENC_SAMPFMT_ENDIAN_BIG) {
+			v = vreinterpretq_s32_u8(
+			    vrev32q_u8(vreinterpretq_u8_s32(v)));
+		}
+
+		sstvenc_sampfmt_widen_neon(out + i, v, scale);
+	}
+
+	sstvenc_sampfmt_s32_to_f64_scalar(out + i, in + i, sz - i,
+					  endianness);
+}
+
+static void sstvenc_sampfmt_f32be_to_f64_neon(double* out, const uint32_t* in,
+					      size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		const float32x4_t f = vreinterpretq_f32_u8(
+		    vrev32q_u8(vreinterpretq_u8_u32(vld1q_u32(in + i))));
+
+		vst1q_f64(out + i, vcvt_f64_f32(vget_low_f32(f)));
+		vst1q_f64(out + i + 2, vcvt_high_f64_f32(f));
+	}
+
+	sstvenc_sampfmt_f32be_to_f64_scalar(out + i, in + i, sz - i);
+}
+
+static void sstvenc_sampfmt_f64be_to_f64_neon(double* out, const uint64_t* in,
+					      size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 2) <= sz; i += 2) {
+		const uint8x16_t v = vreinterpretq_u8_u64(vld1q_u64(in + i));
+		vst1q_f64(out + i, vreinterpretq_f64_u8(vrev64q_u8(v)));
+	}
+
+	sstvenc_sampfmt_f64be_to_f64_scalar(out + i, in + i, sz - i);
+}
+
+/*!
+ * NEON kernels.
+ */
+static const struct sstvenc_sampfmt_ops sstvenc_sampfmt_ops_neon = {
+    .f64_to_s8	  = sstvenc_sampfmt_f64_to_s8_neon,
+    .f64_to_s16	  = sstvenc_sampfmt_f64_to_s16_neon,
+    .f64_to_s32	  = sstvenc_sampfmt_f64_to_s32_neon,
+    .f64_to_f32	  = sstvenc_sampfmt_f64_to_f32_neon,
+    .f64_to_f32be = sstvenc_sampfmt_f64_to_f32be_neon,
+    .f64_to_f64be = sstvenc_sampfmt_f64_to_f64be_neon,
+    .s8_to_f64	  = sstvenc_sampfmt_s8_to_f64_neon,
+    .s16_to_f64	  = sstvenc_sampfmt_s16_to_f64_neon,
+    .s32_to_f64	  = sstvenc_sampfmt_s32_to_f64_neon,
+    .f32be_to_f64 = sstvenc_sampfmt_f32be_to_f64_neon,
+    .f64be_to_f64 = sstvenc_sampfmt_f64be_to_f64_neon,
+};
+#endif
+
+/*!
+ * The kernels chosen for the features the host CPU supports.
+ */
+static const struct sstvenc_sampfmt_ops* sstvenc_sampfmt_ops_detected = NULL;
+
+/*!
+ * Guard for one-time selection of @ref sstvenc_sampfmt_ops_detected.
+ */
+static pthread_once_t			 sstvenc_sampfmt_ops_once
+    = PTHREAD_ONCE_INIT;
+
+/*!
+ * Return the best kernels for the given CPU features.
+ */
+static const struct sstvenc_sampfmt_ops*
+sstvenc_sampfmt_ops_select(uint32_t features) {
+	const struct sstvenc_sampfmt_ops* ops = &sstvenc_sampfmt_ops_scalar;
+#if defined(__x86_64__)
+	if (features & SSTVENC_CPU_FEAT_AVX2) {
+		ops = &sstvenc_sampfmt_ops_avx2;
+	} else if (features & SSTVENC_CPU_FEAT_SSE2) {
+		ops = &sstvenc_sampfmt_ops_sse2;
+	}
+#elif defined(SSTVENC_SAMPFMT_NEON)
+	if (features & SSTVENC_CPU_FEAT_NEON) {
+		ops = &sstvenc_sampfmt_ops_neon;
+	}
+#endif
+
+	return ops;
+}
+
+/*!
+ * Choose the kernels for the host CPU.
+ */
+static void sstvenc_sampfmt_ops_init(void) {
+	sstvenc_sampfmt_ops_detected
+	    = sstvenc_sampfmt_ops_select(sstvenc_cpu_detect());
+}
+
+/*!
+ * Return the best kernels for the permitted CPU features.  The choice for
+ * the host CPU is made once; a restriction set with
+ * @ref sstvenc_cpu_set_features is looked up on each call instead.
+ */
+static const struct sstvenc_sampfmt_ops* sstvenc_sampfmt_ops(void) {
+	const uint32_t features = sstvenc_cpu_get_features();
+
+	pthread_once(&sstvenc_sampfmt_ops_once, sstvenc_sampfmt_ops_init);
+	if (features == sstvenc_cpu_detect()) {
+		return sstvenc_sampfmt_ops_detected;
+	}
+
+	return sstvenc_sampfmt_ops_select(features);
+}
+
+void sstvenc_sampfmt_f64_to_s8(int8_t* out, const double* in, size_t sz) {
+	sstvenc_sampfmt_ops()->f64_to_s8(out, in, sz);
+}
+
+void sstvenc_sampfmt_f64_to_f32(float* out, const double* in, size_t sz) {
+	sstvenc_sampfmt_ops()->f64_to_f32(out, in, sz);
+}
+
+void sstvenc_sampfmt_f64_to_s16(int16_t* out, const double* in, size_t sz,
+				uint8_t endianness) {
+	sstvenc_sampfmt_ops()->f64_to_s16(out, in, sz, endianness);
+}
+
+void sstvenc_sampfmt_f64_to_s32(int32_t* out, const double* in, size_t sz,
+				uint8_t endianness) {
+	sstvenc_sampfmt_ops()->f64_to_s32(out, in, sz, endianness);
+}
+
+void sstvenc_sampfmt_f64_to_f32be(uint32_t* out, const double* in,
+				  size_t sz) {
+	sstvenc_sampfmt_ops()->f64_to_f32be(out, in, sz);
+}
+
+void sstvenc_sampfmt_f64_to_f64be(uint64_t* out, const double* in,
+				  size_t sz) {
+	sstvenc_sampfmt_ops()->f64_to_f64be(out, in, sz);
+}
+
+void sstvenc_sampfmt_s8_to_f64(double* out, const int8_t* in, size_t sz) {
+	sstvenc_sampfmt_ops()->s8_to_f64(out, in, sz);
+}
+
+void sstvenc_sampfmt_s16_to_f64(double* out, const int16_t* in, size_t sz,
+				uint8_t endianness) {
+	sstvenc_sampfmt_ops()->s16_to_f64(out, in, sz, endianness);
+}
+
+void sstvenc_sampfmt_s32_to_f64(double* out, const int32_t* in, size_t sz,
+				uint8_t endianness) {
+	sstvenc_sampfmt_ops()->s32_to_f64(out, in, sz, endianness);
+}
+
+void sstvenc_sampfmt_f32be_to_f64(double* out, const uint32_t* in,
+				  size_t sz) {
+	sstvenc_sampfmt_ops()->f32be_to_f64(out, in, sz);
+}
+
+void sstvenc_sampfmt_f64be_to_f64(double* out, const uint64_t* in,
+				  size_t sz) {
+	sstvenc_sampfmt_ops()->f64be_to_f64(out, in, sz);
+}
+
+/*!
+ * Narrowing conversion used by @ref sstvenc_sampfmt_fill, taking the
+ * already-resolved kernel table.
+ */
+typedef void sstvenc_sampfmt_narrow(const struct sstvenc_sampfmt_ops* ops,
+				    void* out, const double* in, size_t sz,
+				    uint8_t endianness);
+
+static void
+sstvenc_sampfmt_narrow_f32(const struct sstvenc_sampfmt_ops* ops, void* out,
+			   const double* in, size_t sz, uint8_t endianness) {
+	(void)endianness;
+	ops->f64_to_f32((float*)out, in, sz);
+}
+
+static void
+sstvenc_sampfmt_narrow_s16(const struct sstvenc_sampfmt_ops* ops, void* out,
+			   const double* in, size_t sz, uint8_t endianness) {
+	ops->f64_to_s16((int16_t*)out, in, sz, endianness);
+}
+
+/*!
+ * Pull samples from a source in blocks of @ref SSTVENC_SAMPFMT_BLOCK_SZ and
+ * narrow each block into the output buffer.
+ *
+ * @param[out]		out		Output buffer.
+ * @param[in]		sample_sz	Size of one output sample in bytes.
+ * @param[in]		out_sz		Size of the output buffer in samples.
+ * @param[in]		narrow		Conversion to apply to each block.
+ * @param[in]		endianness	Byte order passed to @a narrow.
+ * @param[in]		source		Source of the samples.
+ * @param[inout]	ctx		Context passed to @a source.
+ *
+ * @returns		Number of samples written to @a out.
+ */
+static size_t
+sstvenc_sampfmt_fill(void* out, size_t sample_sz, size_t out_sz,
+		     sstvenc_sampfmt_narrow* narrow, uint8_t endianness,
+		     sstvenc_sampfmt_source* source, void* ctx) {
+	const struct sstvenc_sampfmt_ops* ops	     = sstvenc_sampfmt_ops();
+	uint8_t*			  dest	     = (uint8_t*)out;
+	double				  block[SSTVENC_SAMPFMT_BLOCK_SZ];
+	size_t				  written_sz = 0;
+
+	while (written_sz < out_sz) {
+		size_t block_sz = out_sz - written_sz;
+		if (block_sz > SSTVENC_SAMPFMT_BLOCK_SZ) {
+			block_sz = SSTVENC_SAMPFMT_BLOCK_SZ;
+		}
+
+		size_t sz = source(ctx, block, block_sz);
+		narrow(ops, dest + (written_sz * sample_sz), block, sz,
+		       endianness);
+		written_sz += sz;
+
+		if (sz < block_sz) {
+			/* Source has finished */
+			break;
+		}
+	}
+
+	return written_sz;
+}
+
+size_t sstvenc_sampfmt_fill_f32(float* out, size_t out_sz,
+				sstvenc_sampfmt_source* source, void* ctx) {
+	return sstvenc_sampfmt_fill(out, sizeof(float), out_sz,
+				    sstvenc_sampfmt_narrow_f32, 0, source,
+				    ctx);
+}
+
+size_t sstvenc_sampfmt_fill_s16(int16_t* out, size_t out_sz,
+				uint8_t endianness,
+				sstvenc_sampfmt_source* source, void* ctx) {
+	return sstvenc_sampfmt_fill(out, sizeof(int16_t), out_sz,
+				    sstvenc_sampfmt_narrow_s16, endianness,
+				    source, ctx);
+}
+
+/*! @} */
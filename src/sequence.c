@@ -9,6 +9,7 @@
  */
 
 #include <assert.h>
+#include <libsstvenc/sampfmt.h>
 #include <libsstvenc/sequence.h>
 
 void sstvenc_sequencer_step_set_timescale(
@@ -140,9 +141,18 @@ sstvenc_sequencer_reset_internal(struct sstvenc_sequencer* const seq) {
 	seq->regs[SSTVENC_SEQ_REG_PULSE_RISE] = 0.002;
 	seq->regs[SSTVENC_SEQ_REG_PULSE_FALL] = 0.002;
 	seq->regs[SSTVENC_SEQ_REG_DIT_PERIOD] = 0.05;
+	seq->regs[SSTVENC_SEQ_REG_OSC_KERNEL] = SSTVENC_OSC_KERNEL_LIBM;
 	seq->time_unit			      = SSTVENC_TS_UNIT_SECONDS;
 }
 
+/*!
+ * Return the oscillator sine kernel selected by the kernel register.
+ */
+static uint8_t
+sstvenc_sequencer_get_kernel(const struct sstvenc_sequencer* const seq) {
+	return (uint8_t)seq->regs[SSTVENC_SEQ_REG_OSC_KERNEL];
+}
+
 void sstvenc_sequencer_init(struct sstvenc_sequencer* const	 seq,
 			    const struct sstvenc_sequencer_step* steps,
 			    sstvenc_sequencer_event_cb*		 event_cb,
@@ -151,6 +161,7 @@ void sstvenc_sequencer_init(struct sstvenc_sequencer* const	 seq,
 	seq->steps	  = steps;
 	seq->event_cb	  = event_cb;
 	seq->event_cb_ctx = event_cb_ctx;
+	seq->sample_rate  = sample_rate;
 	sstvenc_sequencer_reset_internal(seq);
 }
 
@@ -182,6 +193,16 @@ static void sstvenc_sequencer_next_state(struct sstvenc_sequencer* const seq,
 	}
 }
 
+/*!
+ * Finish the current step: enter the given "end" state and move on to the
+ * next step, which will be executed on the next sample.
+ */
+static void sstvenc_sequencer_end_step(struct sstvenc_sequencer* const seq,
+				       uint8_t state) {
+	sstvenc_sequencer_next_state(seq, state, true);
+	sstvenc_sequencer_next_step(seq, false);
+}
+
 /*!
  * Abort the state machine with an error.
  */
@@ -209,9 +230,10 @@ static void sstvenc_sequencer_exec_set_ts(
 		    = sstvenc_ts_unit_scale(step->args.ts.time_unit);
 		double scale = (double)new_scale / (double)old_scale;
 
-		for (uint8_t reg = 0; reg < SSTVENC_SEQ_NUM_REGS; reg++) {
-			seq->regs[reg] *= scale;
-		}
+		/* Only the time period registers are affected */
+		seq->regs[SSTVENC_SEQ_REG_PULSE_RISE] *= scale;
+		seq->regs[SSTVENC_SEQ_REG_PULSE_FALL] *= scale;
+		seq->regs[SSTVENC_SEQ_REG_DIT_PERIOD] *= scale;
 	}
 
 	/* Apply new unit setting */
@@ -285,8 +307,7 @@ static void sstvenc_sequencer_begin_tone(
     struct sstvenc_sequencer* const	       seq,
     const struct sstvenc_sequencer_step* const step) {
 	_Bool init_osc = seq->state != SSTVENC_SEQ_STATE_END_TONE;
-	sstvenc_sequencer_next_state(seq, SSTVENC_SEQ_STATE_BEGIN_SILENCE,
-				     true);
+	sstvenc_sequencer_next_state(seq, SSTVENC_SEQ_STATE_BEGIN_TONE, true);
 
 	sstvenc_ps_init(
 	    &(seq->vars.tone.ps), seq->regs[SSTVENC_SEQ_REG_AMPLITUDE],
@@ -303,7 +324,8 @@ static void sstvenc_sequencer_begin_tone(
 		sstvenc_osc_init(&(seq->vars.tone.osc), 0.0,
 				 seq->regs[SSTVENC_SEQ_REG_FREQUENCY],
 				 seq->regs[SSTVENC_SEQ_REG_PHASE],
-				 seq->sample_rate);
+				 seq->sample_rate,
+				 sstvenc_sequencer_get_kernel(seq));
 	} else {
 		sstvenc_osc_set_frequency(
 		    &(seq->vars.tone.osc),
@@ -330,7 +352,8 @@ sstvenc_sequencer_begin_cw(struct sstvenc_sequencer* const	      seq,
 			seq->regs[SSTVENC_SEQ_REG_FREQUENCY],
 			seq->regs[SSTVENC_SEQ_REG_DIT_PERIOD],
 			seq->regs[SSTVENC_SEQ_REG_PULSE_RISE],
-			seq->sample_rate, seq->time_unit);
+			seq->sample_rate, seq->time_unit,
+			sstvenc_sequencer_get_kernel(seq));
 
 	sstvenc_sequencer_next_state(seq, SSTVENC_SEQ_STATE_GEN_CW, true);
 }
@@ -344,9 +367,10 @@ static void sstvenc_sequencer_begin_image(
 	sstvenc_modulator_init(&(seq->vars.sstv), step->args.image.mode,
 			       step->args.image.fsk_id,
 			       step->args.image.framebuffer,
-			       seq->regs[SSTVENC_SEQ_REG_DIT_PERIOD],
 			       seq->regs[SSTVENC_SEQ_REG_PULSE_RISE],
-			       seq->sample_rate, seq->time_unit);
+			       seq->regs[SSTVENC_SEQ_REG_PULSE_FALL],
+			       seq->sample_rate, seq->time_unit,
+			       sstvenc_sequencer_get_kernel(seq));
 	seq->vars.sstv.ps.amplitude = seq->regs[SSTVENC_SEQ_REG_AMPLITUDE];
 
 	sstvenc_sequencer_next_state(seq, SSTVENC_SEQ_STATE_GEN_IMAGE, true);
@@ -394,8 +418,11 @@ sstvenc_sequencer_next_ausrc_sample(struct sstvenc_sequencer* const seq) {
 			    step->args.audio.src);
 			if (res < 0) {
 				sstvenc_sequencer_abort(seq, -res);
+				return;
 			}
 		}
+
+		sstvenc_sequencer_end_step(seq, SSTVENC_SEQ_STATE_END_AUDIO);
 	}
 }
 
@@ -544,15 +571,17 @@ retry:
 		sstvenc_sequencer_exec_step(seq);
 		goto retry;
 		break;
+	case SSTVENC_SEQ_STATE_GEN_INF_SILENCE:
+		seq->output = 0.0;
+		break;
 	case SSTVENC_SEQ_STATE_BEGIN_SILENCE:
 	case SSTVENC_SEQ_STATE_GEN_SILENCE:
-	case SSTVENC_SEQ_STATE_GEN_INF_SILENCE:
 		seq->output = 0.0;
 		if (seq->vars.silence.remaining > 0) {
 			seq->vars.silence.remaining--;
 		} else {
-			sstvenc_sequencer_next_state(
-			    seq, SSTVENC_SEQ_STATE_END_SILENCE, true);
+			sstvenc_sequencer_end_step(
+			    seq, SSTVENC_SEQ_STATE_END_SILENCE);
 			goto retry;
 		}
 		break;
@@ -565,8 +594,8 @@ retry:
 		seq->output = seq->vars.tone.osc.output;
 
 		if (seq->vars.tone.ps.phase >= SSTVENC_PS_PHASE_DONE) {
-			sstvenc_sequencer_next_state(
-			    seq, SSTVENC_SEQ_STATE_END_TONE, true);
+			sstvenc_sequencer_end_step(
+			    seq, SSTVENC_SEQ_STATE_END_TONE);
 			goto retry;
 		}
 		break;
@@ -576,8 +605,8 @@ retry:
 		seq->output = seq->vars.cw.output;
 
 		if (seq->vars.cw.state >= SSTVENC_CW_MOD_STATE_DONE) {
-			sstvenc_sequencer_next_state(
-			    seq, SSTVENC_SEQ_STATE_END_CW, true);
+			sstvenc_sequencer_end_step(
+			    seq, SSTVENC_SEQ_STATE_END_CW);
 			goto retry;
 		}
 		break;
@@ -587,8 +616,8 @@ retry:
 		seq->output = seq->vars.sstv.osc.output;
 
 		if (seq->vars.sstv.ps.phase >= SSTVENC_PS_PHASE_DONE) {
-			sstvenc_sequencer_next_state(
-			    seq, SSTVENC_SEQ_STATE_END_IMAGE, true);
+			sstvenc_sequencer_end_step(
+			    seq, SSTVENC_SEQ_STATE_END_IMAGE);
 			goto retry;
 		}
 		break;
@@ -602,11 +631,42 @@ retry:
 	}
 }
 
+/*!
+ * Render a block of tone samples.  This is equivalent to calling
+ * @ref sstvenc_sequencer_compute whilst in the tone states: the sample on
+ * which the pulse shaper finishes is not emitted, instead we move on to the
+ * next step which will supply that sample on the next call.
+ */
+static size_t sstvenc_sequencer_fill_tone(struct sstvenc_sequencer* const seq,
+					  double* buffer, size_t buffer_sz) {
+	size_t sz = sstvenc_ps_fill(&(seq->vars.tone.ps), buffer, buffer_sz);
+	sstvenc_osc_fill_env(&(seq->vars.tone.osc), buffer, buffer, sz);
+	seq->output = seq->vars.tone.osc.output;
+
+	if (seq->vars.tone.ps.phase >= SSTVENC_PS_PHASE_DONE) {
+		sstvenc_sequencer_end_step(seq, SSTVENC_SEQ_STATE_END_TONE);
+		sz--;
+	}
+
+	return sz;
+}
+
 size_t sstvenc_sequencer_fill_buffer(struct sstvenc_sequencer* const seq,
 				     double* buffer, size_t buffer_sz) {
 	size_t written_sz = 0;
 
 	while ((buffer_sz > 0) && (seq->state < SSTVENC_SEQ_STATE_DONE)) {
+		if (((seq->state == SSTVENC_SEQ_STATE_GEN_TONE)
+		     || (seq->state == SSTVENC_SEQ_STATE_GEN_INF_TONE))
+		    && (seq->vars.tone.ps.phase < SSTVENC_PS_PHASE_DONE)) {
+			size_t sz = sstvenc_sequencer_fill_tone(seq, buffer,
+								buffer_sz);
+			buffer	   += sz;
+			buffer_sz  -= sz;
+			written_sz += sz;
+			continue;
+		}
+
 		sstvenc_sequencer_compute(seq);
 
 		buffer[0] = seq->output;
@@ -618,3 +678,25 @@ size_t sstvenc_sequencer_fill_buffer(struct sstvenc_sequencer* const seq,
 
 	return written_sz;
 }
+
+/*!
+ * Sample source for the narrow-format fill functions, see @ref sampfmt.
+ */
+static size_t sstvenc_sequencer_source(void* ctx, double* buffer,
+				       size_t buffer_sz) {
+	return sstvenc_sequencer_fill_buffer(ctx, buffer, buffer_sz);
+}
+
+size_t
+sstvenc_sequencer_fill_buffer_f32(struct sstvenc_sequencer* const seq,
+				  float* buffer, size_t buffer_sz) {
+	return sstvenc_sampfmt_fill_f32(buffer, buffer_sz,
+					sstvenc_sequencer_source, seq);
+}
+
+size_t sstvenc_sequencer_fill_s16(struct sstvenc_sequencer* const seq,
+				  int16_t* buffer, size_t buffer_sz,
+				  uint8_t endianness) {
+	return sstvenc_sampfmt_fill_s16(buffer, buffer_sz, endianness,
+					sstvenc_sequencer_source, seq);
+}
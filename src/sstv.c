@@ -15,8 +15,10 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <libsstvenc/sstv.h>
 #include <libsstvenc/sstvfreq.h>
+#include <stdbool.h>
 
 /*!
  * @defgroup sstv_vis_bit SSTV VIS header bits
@@ -154,6 +156,12 @@
 #define SSTVENC_ENCODER_SCAN_SEGMENT_NEXT	(9)
 /*! @} */
 
+/*!
+ * Most pixels computed at a time whilst looking for the end of a run of
+ * pixels at the same level.  This buffer lives on the stack.
+ */
+#define SSTVENC_ENCODER_RUN_SZ			(64)
+
 /*!
  * Transition the encoder to the next phase.  Used as a debugging attachment
  * point in development.
@@ -332,6 +340,57 @@ static void sstvenc_encoder_begin_gap23(struct sstvenc_encoder* const enc);
 static void
 sstvenc_encoder_begin_backporch(struct sstvenc_encoder* const enc);
 
+/*!
+ * Compute one pulse for each of @a count pixels of channel @a ch of the
+ * current scan line, starting at column @a x.
+ *
+ * @param[in]		enc		SSTV encoder instance
+ * @param[in]		ch		Scan line channel (0-3 inclusive)
+ * @param[in]		x		First column
+ * @param[out]		pulses		Array to write the pulses to
+ * @param[in]		count		Number of pixels
+ */
+static void
+sstvenc_encoder_channel_pixels(const struct sstvenc_encoder* const enc,
+			       uint8_t ch, uint16_t x,
+			       struct sstvenc_encoder_pulse* pulses,
+			       size_t			     count);
+
+/*!
+ * Compute up to @a max pulses of channel @a ch of the current scan line,
+ * starting at sstvenc_encoder_phase_scan_data#x.  Adjacent pixels at the
+ * same level are merged into one pulse lasting the sum of their durations,
+ * so each pixel edge still falls on the same nanosecond.
+ *
+ * @param[inout]	enc		SSTV encoder instance
+ * @param[in]		ch		Scan line channel (0-3 inclusive)
+ * @param[out]		pulses		Array to write the pulses to
+ * @param[in]		max		Maximum number of pulses to write
+ *
+ * @returns	Number of pulses written, 0 if the channel is not used or
+ * 		has been sent in full.
+ */
+static size_t
+sstvenc_encoder_channel_pulses(struct sstvenc_encoder* const enc, uint8_t ch,
+			       struct sstvenc_encoder_pulse* pulses,
+			       size_t			     max);
+
+/*!
+ * Compute the pulses for the remaining pixels of the scan line channel being
+ * transmitted, up to the given limit.
+ *
+ * @param[inout]	enc		SSTV encoder instance
+ * @param[out]		pulses		Array to write the pulses to
+ * @param[in]		max		Maximum number of pulses to write
+ *
+ * @returns	Number of pulses written, 0 if the encoder is not in the
+ * 		middle of a scan line channel.
+ */
+static size_t
+sstvenc_encoder_next_channel_pulses(struct sstvenc_encoder* const enc,
+				    struct sstvenc_encoder_pulse* pulses,
+				    size_t			  max);
+
 /*!
  * Compute the frequency of the next pulse for the current pixel in the
  * indicated scan line.
@@ -397,6 +456,22 @@ void sstvenc_encoder_init(struct sstvenc_encoder* const enc,
 	enc->fsk_id	 = fsk_id;
 	enc->framebuffer = framebuffer;
 	enc->phase	 = SSTVENC_ENCODER_PHASE_INIT;
+
+	for (uint8_t ch = 0; ch < 4; ch++) {
+		sstvenc_encoder_channel_init(&(enc->channel[ch]), mode, ch);
+	}
+}
+
+void sstvenc_encoder_init_channels(
+    struct sstvenc_encoder* const enc, const struct sstvenc_mode* mode,
+    const char* fsk_id, const uint8_t* framebuffer,
+    const struct sstvenc_encoder_channel* channel) {
+	memset(enc, 0, sizeof(struct sstvenc_encoder));
+	enc->mode	 = mode;
+	enc->fsk_id	 = fsk_id;
+	enc->framebuffer = framebuffer;
+	enc->phase	 = SSTVENC_ENCODER_PHASE_INIT;
+	memcpy(enc->channel, channel, sizeof(enc->channel));
 }
 
 static void sstvenc_encoder_begin_seq(struct sstvenc_encoder* const	  enc,
@@ -585,92 +660,286 @@ sstvenc_encoder_begin_scanline(struct sstvenc_encoder* const enc) {
 
 static void sstvenc_encoder_begin_channel(struct sstvenc_encoder* const enc,
 					  uint8_t segment, uint8_t ch) {
+	(void)ch; /* Only used for debugging */
 #ifdef _DEBUG_SSTV
 	printf("%s: begin row %u channel %u\n", __func__, enc->vars.scan.y,
 	       ch);
 #endif
 	sstvenc_encoder_next_scan_seg(enc, segment);
 	enc->vars.scan.x = 0;
-	enc->pulse.duration_ns
-	    = (uint32_t)((((double)enc->mode->scanline_period_ns[ch])
-			  / enc->mode->width)
-			 + 0.5);
 #ifdef _DEBUG_SSTV
 	printf("%s: %" PRIu32 " ns per pixel\n", __func__,
-	       enc->pulse.duration_ns);
+	       enc->channel[ch].px_ns);
 #endif
 }
 
-static const struct sstvenc_encoder_pulse*
-sstvenc_encoder_next_channel_pulse(struct sstvenc_encoder* const enc,
-				   uint8_t			 ch) {
+/*!
+ * Pixel frequencies for each signal level, as given by
+ * @ref sstvenc_level_freq, so pixel pulses need not compute them.
+ */
+static const uint16_t sstvenc_level_freq_lut[UINT8_MAX + 1] = {
+    1500, 1503, 1506, 1509, 1513, 1516, 1519, 1522, 1525, 1528, 1531, 1535,
+    1538, 1541, 1544, 1547, 1550, 1553, 1556, 1560, 1563, 1566, 1569, 1572,
+    1575, 1578, 1582, 1585, 1588, 1591, 1594, 1597, 1600, 1604, 1607, 1610,
+    1613, 1616, 1619, 1622, 1625, 1629, 1632, 1635, 1638, 1641, 1644, 1647,
+    1651, 1654, 1657, 1660, 1663, 1666, 1669, 1673, 1676, 1679, 1682, 1685,
+    1688, 1691, 1695, 1698, 1701, 1704, 1707, 1710, 1713, 1716, 1720, 1723,
+    1726, 1729, 1732, 1735, 1738, 1742, 1745, 1748, 1751, 1754, 1757, 1760,
+    1764, 1767, 1770, 1773, 1776, 1779, 1782, 1785, 1789, 1792, 1795, 1798,
+    1801, 1804, 1807, 1811, 1814, 1817, 1820, 1823, 1826, 1829, 1833, 1836,
+    1839, 1842, 1845, 1848, 1851, 1855, 1858, 1861, 1864, 1867, 1870, 1873,
+    1876, 1880, 1883, 1886, 1889, 1892, 1895, 1898, 1902, 1905, 1908, 1911,
+    1914, 1917, 1920, 1924, 1927, 1930, 1933, 1936, 1939, 1942, 1945, 1949,
+    1952, 1955, 1958, 1961, 1964, 1967, 1971, 1974, 1977, 1980, 1983, 1986,
+    1989, 1993, 1996, 1999, 2002, 2005, 2008, 2011, 2015, 2018, 2021, 2024,
+    2027, 2030, 2033, 2036, 2040, 2043, 2046, 2049, 2052, 2055, 2058, 2062,
+    2065, 2068, 2071, 2074, 2077, 2080, 2084, 2087, 2090, 2093, 2096, 2099,
+    2102, 2105, 2109, 2112, 2115, 2118, 2121, 2124, 2127, 2131, 2134, 2137,
+    2140, 2143, 2146, 2149, 2153, 2156, 2159, 2162, 2165, 2168, 2171, 2175,
+    2178, 2181, 2184, 2187, 2190, 2193, 2196, 2200, 2203, 2206, 2209, 2212,
+    2215, 2218, 2222, 2225, 2228, 2231, 2234, 2237, 2240, 2244, 2247, 2250,
+    2253, 2256, 2259, 2262, 2265, 2269, 2272, 2275, 2278, 2281, 2284, 2287,
+    2291, 2294, 2297, 2300
+};
 
-	if (enc->vars.scan.x >= enc->mode->width) {
-		/* End of the channel */
-		return NULL;
+/*!
+ * Define a scan line emitter.
+ *
+ * @param	name	Name of the emitter function
+ * @param	stride	Framebuffer values between adjacent pixels
+ * @param	value	Expression giving the level of the pixel at `px`
+ */
+#define SSTVENC_ENCODER_EMITTER(name, stride, value)                         \
+	static void name(const struct sstvenc_encoder_channel* const chan,   \
+			 const uint8_t*			     px,             \
+			 struct sstvenc_encoder_pulse*	     pulses,         \
+			 size_t				     count) {        \
+		(void)chan;                                                  \
+		for (size_t i = 0; i < count; i++) {                         \
+			const uint8_t level = (value);                       \
+			pulses[i].frequency = sstvenc_level_freq_lut[level]; \
+			pulses[i].level	    = level;                         \
+			pulses[i].flags	    = SSTVENC_PULSE_FLAG_PIXEL;      \
+			px		   += (stride);                      \
+		}                                                            \
 	}
 
-	uint32_t idx = sstvenc_get_pixel_posn(enc->mode, enc->vars.scan.x,
-					      enc->vars.scan.y);
-	uint8_t	 value;
+/*! Monochrome modes: one value per pixel */
+SSTVENC_ENCODER_EMITTER(sstvenc_encoder_emit_mono, 1, px[0])
 
-	switch (enc->mode->colour_space_order & SSTVENC_CSO_MASK_MODE) {
-	case SSTVENC_CSO_MODE_YUV2: {
-		const uint16_t row_length = 3 * enc->mode->width;
-		assert(!(enc->vars.scan.y % 2));
-
-		switch (
-		    SSTVENC_MODE_GET_CH(ch, enc->mode->colour_space_order)) {
-		case SSTVENC_CSO_CH_NONE:
-			/* Channel not used */
-			return NULL;
+/*! RGB, YUV and YUV2 luminance channels: one of three values per pixel */
+SSTVENC_ENCODER_EMITTER(sstvenc_encoder_emit_colour, 3, px[0])
+
+/*! YUV2 chrominance: average of this row and the next */
+SSTVENC_ENCODER_EMITTER(sstvenc_encoder_emit_yuv2, 3,
+			(px[0] + px[chan->pair]) / 2)
+
+/*! Channels the mode defines but the colour space has no value for */
+SSTVENC_ENCODER_EMITTER(sstvenc_encoder_emit_blank, 0, 0)
+
+void sstvenc_encoder_channel_init(struct sstvenc_encoder_channel* const chan,
+				  const struct sstvenc_mode* mode,
+				  uint8_t		     ch) {
+	const uint16_t cso	  = mode->colour_space_order;
+	const uint32_t row_length = 3 * mode->width;
+	const uint8_t  src	  = SSTVENC_MODE_GET_CH(ch, cso);
+
+	chan->emit   = NULL;
+	chan->offset = 0;
+	chan->pair   = 0;
+	chan->px_ns  = mode->scanline_period_ns[ch] / mode->width;
+	chan->px_rem = mode->scanline_period_ns[ch] % mode->width;
+
+	if (src == SSTVENC_CSO_CH_NONE) {
+		/* Channel not used */
+		return;
+	}
+
+	switch (cso & SSTVENC_CSO_MASK_MODE) {
+	case SSTVENC_CSO_MODE_MONO:
+		if (src == SSTVENC_CSO_CH_Y) {
+			chan->emit = sstvenc_encoder_emit_mono;
+		} else {
+			chan->emit = sstvenc_encoder_emit_blank;
+		}
+		break;
+	case SSTVENC_CSO_MODE_YUV2:
+		switch (src) {
 		case SSTVENC_CSO_CH_Y:
-			value = enc->framebuffer[idx];
+			chan->emit = sstvenc_encoder_emit_colour;
 			break;
 		case SSTVENC_CSO_CH_Y2:
-			value = enc->framebuffer[idx + row_length];
+			chan->emit   = sstvenc_encoder_emit_colour;
+			chan->offset = row_length;
 			break;
 		case SSTVENC_CSO_CH_U:
-			value = (enc->framebuffer[idx + 1]
-				 + enc->framebuffer[idx + row_length + 1])
-				/ 2.0;
+			chan->emit   = sstvenc_encoder_emit_yuv2;
+			chan->offset = 1;
+			chan->pair   = row_length;
 			break;
 		case SSTVENC_CSO_CH_V:
-			value = (enc->framebuffer[idx + 2]
-				 + enc->framebuffer[idx + row_length + 2])
-				/ 2.0;
+			chan->emit   = sstvenc_encoder_emit_yuv2;
+			chan->offset = 2;
+			chan->pair   = row_length;
 			break;
 		default:
-			value = 0.0;
+			chan->emit = sstvenc_encoder_emit_blank;
 		}
 		break;
-	}
 	default:
-		switch (
-		    SSTVENC_MODE_GET_CH(ch, enc->mode->colour_space_order)) {
-		case SSTVENC_CSO_CH_NONE:
-			/* Channel not used */
-			return NULL;
+		switch (src) {
 		case SSTVENC_CSO_CH_Y:
 		case SSTVENC_CSO_CH_R:
-			value = enc->framebuffer[idx];
+			chan->emit = sstvenc_encoder_emit_colour;
 			break;
 		case SSTVENC_CSO_CH_U:
 		case SSTVENC_CSO_CH_G:
-			value = enc->framebuffer[idx + 1];
+			chan->emit   = sstvenc_encoder_emit_colour;
+			chan->offset = 1;
 			break;
 		case SSTVENC_CSO_CH_V:
 		case SSTVENC_CSO_CH_B:
-			value = enc->framebuffer[idx + 2];
+			chan->emit   = sstvenc_encoder_emit_colour;
+			chan->offset = 2;
 			break;
 		default:
-			value = 0.0;
+			chan->emit = sstvenc_encoder_emit_blank;
 		}
 	}
+}
 
-	enc->pulse.frequency = sstvenc_level_freq(value);
-	enc->vars.scan.x++;
-	return &(enc->pulse);
+static void
+sstvenc_encoder_channel_pixels(const struct sstvenc_encoder* const enc,
+			       uint8_t ch, uint16_t x,
+			       struct sstvenc_encoder_pulse* pulses,
+			       size_t			     count) {
+	const struct sstvenc_encoder_channel* const chan
+	    = &(enc->channel[ch]);
+
+	chan->emit(chan,
+		   enc->framebuffer
+		       + sstvenc_get_pixel_posn(enc->mode, x,
+						enc->vars.scan.y)
+		       + chan->offset,
+		   pulses, count);
+
+	/*
+	 * Place each pixel edge at the nearest nanosecond to its exact
+	 * position so the pixels sum to the channel period.  `err` tracks
+	 * the fractional part of the edge position in units of 1/width ns.
+	 */
+	const uint32_t width = enc->mode->width;
+	const uint64_t start
+	    = ((uint64_t)x) * enc->mode->scanline_period_ns[ch];
+	uint32_t err = (uint32_t)((start + (width / 2)) % width);
+
+	for (size_t i = 0; i < count; i++) {
+		pulses[i].duration_ns  = chan->px_ns;
+		err		      += chan->px_rem;
+		if (err >= width) {
+			pulses[i].duration_ns++;
+			err -= width;
+		}
+	}
+}
+
+static size_t
+sstvenc_encoder_channel_pulses(struct sstvenc_encoder* const enc, uint8_t ch,
+			       struct sstvenc_encoder_pulse* pulses,
+			       size_t			     max) {
+	struct sstvenc_encoder_pulse run[SSTVENC_ENCODER_RUN_SZ];
+	size_t			     run_sz = SSTVENC_ENCODER_RUN_SZ;
+	size_t			     count  = 0;
+	bool			     full   = false;
+
+	if (!enc->channel[ch].emit) {
+		/* Channel not used */
+		return 0;
+	}
+
+	/*
+	 * Compute one pixel more than there are pulses left to fill, so a
+	 * caller asking for a single pulse doesn't pay for a whole block.
+	 * Each time a run carries on past the pixels computed, double the
+	 * number computed next time.
+	 */
+	if (max < (run_sz - 1)) {
+		run_sz = max + 1;
+	}
+
+	while ((!full) && (enc->vars.scan.x < enc->mode->width)) {
+		size_t sz = enc->mode->width - enc->vars.scan.x;
+		if (sz > run_sz) {
+			sz = run_sz;
+		}
+
+		sstvenc_encoder_channel_pixels(enc, ch, enc->vars.scan.x, run,
+					       sz);
+
+		for (size_t i = 0; i < sz; i++) {
+			if (count
+			    && (run[i].level == pulses[count - 1].level)) {
+				/* Same level, extend the pulse */
+				pulses[count - 1].duration_ns
+				    += run[i].duration_ns;
+			} else if (count < max) {
+				pulses[count] = run[i];
+				count++;
+			} else {
+				/* Pixel is left for the next call */
+				full = true;
+				break;
+			}
+			enc->vars.scan.x++;
+		}
+
+		run_sz *= 2;
+		if (run_sz > SSTVENC_ENCODER_RUN_SZ) {
+			run_sz = SSTVENC_ENCODER_RUN_SZ;
+		}
+	}
+
+	if (!count) {
+		/* End of the channel */
+		return 0;
+	}
+
+	enc->pulse = pulses[count - 1];
+	return count;
+}
+
+static size_t
+sstvenc_encoder_next_channel_pulses(struct sstvenc_encoder* const enc,
+				    struct sstvenc_encoder_pulse* pulses,
+				    size_t			  max) {
+	if (enc->phase != SSTVENC_ENCODER_PHASE_SCAN) {
+		return 0;
+	}
+
+	switch (enc->vars.scan.segment) {
+	case SSTVENC_ENCODER_SCAN_SEGMENT_CH0:
+		return sstvenc_encoder_channel_pulses(enc, 0, pulses, max);
+	case SSTVENC_ENCODER_SCAN_SEGMENT_CH1:
+		return sstvenc_encoder_channel_pulses(enc, 1, pulses, max);
+	case SSTVENC_ENCODER_SCAN_SEGMENT_CH2:
+		return sstvenc_encoder_channel_pulses(enc, 2, pulses, max);
+	case SSTVENC_ENCODER_SCAN_SEGMENT_CH3:
+		return sstvenc_encoder_channel_pulses(enc, 3, pulses, max);
+	default:
+		return 0;
+	}
+}
+
+static const struct sstvenc_encoder_pulse*
+sstvenc_encoder_next_channel_pulse(struct sstvenc_encoder* const enc,
+				   uint8_t			 ch) {
+	struct sstvenc_encoder_pulse pulse;
+
+	if (sstvenc_encoder_channel_pulses(enc, ch, &pulse, 1)) {
+		return &(enc->pulse);
+	} else {
+		return NULL;
+	}
 }
 
 static void
@@ -1023,6 +1292,7 @@ sstvenc_encoder_next_fsk_pulse(struct sstvenc_encoder* const enc) {
 		enc->pulse.frequency = SSTVENC_FREQ_FSKID_BIT0;
 	}
 	enc->pulse.duration_ns = 1000 * SSTVENC_PERIOD_FSKID_BIT;
+	enc->pulse.flags       = 0;
 	enc->vars.fsk.bit++;
 
 	return &(enc->pulse);
@@ -1105,6 +1375,127 @@ sstvenc_encoder_next_pulse(struct sstvenc_encoder* const enc) {
 	return pulse;
 }
 
+size_t sstvenc_encoder_next_pulses(struct sstvenc_encoder* const enc,
+				   struct sstvenc_encoder_pulse* pulses,
+				   size_t			 max) {
+	size_t count = 0;
+
+	while ((count < max) && (enc->phase != SSTVENC_ENCODER_PHASE_DONE)) {
+		/* Whole runs of pixels can be computed in one go */
+		size_t sz = sstvenc_encoder_next_channel_pulses(
+		    enc, pulses + count, max - count);
+		if (sz) {
+			count += sz;
+			continue;
+		}
+
+		/* Anything else, one pulse at a time */
+		const struct sstvenc_encoder_pulse* pulse
+		    = sstvenc_encoder_next_pulse(enc);
+		if (pulse) {
+			pulses[count] = *pulse;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*!
+ * Work out which pulse sequence the encoder would be emitting in its current
+ * phase and scan line segment.
+ *
+ * @param[in]		enc		SSTV encoder instance
+ * @param[out]		on_done		Callback run at the end of the
+ * 					sequence.
+ *
+ * @returns	The pulse sequence, or NULL if the encoder does not emit a
+ * 		pulse sequence at this point.
+ */
+static const struct sstvenc_encoder_pulse*
+sstvenc_encoder_get_seq(const struct sstvenc_encoder* const enc,
+			sstvenc_encoder_callback**	    on_done) {
+	*on_done = NULL;
+
+	switch (enc->phase) {
+	case SSTVENC_ENCODER_PHASE_INITSEQ:
+		*on_done = sstvenc_encoder_on_initseq_done;
+		return enc->mode->initseq;
+	case SSTVENC_ENCODER_PHASE_FINALSEQ:
+		*on_done = sstvenc_encoder_on_finalseq_done;
+		return enc->mode->finalseq;
+	case SSTVENC_ENCODER_PHASE_SCAN:
+		switch (enc->vars.scan.segment) {
+		case SSTVENC_ENCODER_SCAN_SEGMENT_FRONTPORCH:
+			return enc->mode->frontporch;
+		case SSTVENC_ENCODER_SCAN_SEGMENT_GAP01:
+			return enc->mode->gap01;
+		case SSTVENC_ENCODER_SCAN_SEGMENT_GAP12:
+			return enc->mode->gap12;
+		case SSTVENC_ENCODER_SCAN_SEGMENT_GAP23:
+			return enc->mode->gap23;
+		case SSTVENC_ENCODER_SCAN_SEGMENT_BACKPORCH:
+			return enc->mode->backporch;
+		default:
+			return NULL;
+		}
+	default:
+		return NULL;
+	}
+}
+
+void sstvenc_encoder_snapshot(const struct sstvenc_encoder* const enc,
+			      struct sstvenc_encoder_snapshot* const snap) {
+	sstvenc_encoder_callback*	    on_done;
+	const struct sstvenc_encoder_pulse* seq
+	    = sstvenc_encoder_get_seq(enc, &on_done);
+
+	snap->pulse    = enc->pulse;
+	snap->vars     = enc->vars;
+	snap->vis_code = enc->mode->vis_code;
+	snap->phase    = enc->phase;
+
+	if (seq && enc->seq) {
+		snap->seq_idx = (int16_t)(enc->seq - seq);
+	} else {
+		snap->seq_idx = -1;
+	}
+}
+
+int sstvenc_encoder_restore(struct sstvenc_encoder* const	   enc,
+			    const struct sstvenc_encoder_snapshot* snap) {
+	struct sstvenc_encoder		    restored = *enc;
+	sstvenc_encoder_callback*	    on_done;
+	const struct sstvenc_encoder_pulse* seq;
+
+	if ((snap->vis_code != enc->mode->vis_code)
+	    || (snap->phase > SSTVENC_ENCODER_PHASE_DONE)) {
+		return -EINVAL;
+	}
+
+	restored.pulse	     = snap->pulse;
+	restored.vars	     = snap->vars;
+	restored.phase	     = snap->phase;
+	restored.seq	     = NULL;
+	restored.seq_done_cb = NULL;
+	seq		     = sstvenc_encoder_get_seq(&restored, &on_done);
+
+	if ((snap->seq_idx >= 0) && seq) {
+		/* Make sure the position lies within the sequence */
+		for (int16_t i = 0; i < snap->seq_idx; i++) {
+			if (!seq[i].duration_ns) {
+				return -EINVAL;
+			}
+		}
+
+		restored.seq	     = seq + snap->seq_idx;
+		restored.seq_done_cb = on_done;
+	}
+
+	*enc = restored;
+	return 0;
+}
+
 /*!
  * @}
  */
@@ -25,6 +25,12 @@ uint16_t sstvenc_level_freq(uint8_t level) {
 	}
 }
 
+double sstvenc_level_freq_exact(uint8_t level) {
+	return SSTVENC_FREQ_BLACK
+	       + ((level * (double)(SSTVENC_FREQ_WHITE - SSTVENC_FREQ_BLACK))
+		  / UINT8_MAX);
+}
+
 /*!
  * @}
  */
@@ -8,27 +8,106 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <errno.h>
+#include <libsstvenc/sampfmt.h>
 #include <libsstvenc/sstvfreq.h>
 #include <libsstvenc/sstvmod.h>
 
+void sstvenc_mode_plan_init(struct sstvenc_mode_plan* const plan,
+			    const struct sstvenc_mode*	    mode,
+			    uint32_t			    sample_rate) {
+	plan->mode	  = mode;
+	plan->sample_rate = sample_rate;
+
+	for (uint8_t ch = 0; ch < 4; ch++) {
+		sstvenc_encoder_channel_init(&(plan->channel[ch]), mode, ch);
+	}
+
+	/* Pre-compute the oscillator settings for each pixel level */
+	for (uint16_t level = 0; level <= UINT8_MAX; level++) {
+		plan->level_phase_inc[level] = sstvenc_osc_freq_phase_inc(
+		    sample_rate, sstvenc_level_freq_exact(level));
+	}
+}
+
 void sstvenc_modulator_init(struct sstvenc_mod* const  mod,
 			    const struct sstvenc_mode* mode,
 			    const char* fsk_id, const uint8_t* framebuffer,
 			    double rise_time, double fall_time,
-			    uint32_t sample_rate, uint8_t time_unit) {
+			    uint32_t sample_rate, uint8_t time_unit,
+			    uint8_t kernel) {
+	struct sstvenc_mode_plan plan;
+
+	sstvenc_mode_plan_init(&plan, mode, sample_rate);
+	sstvenc_modulator_init_plan(mod, &plan, fsk_id, framebuffer,
+				    rise_time, fall_time, time_unit, kernel);
+}
+
+void sstvenc_modulator_init_plan(struct sstvenc_mod* const	   mod,
+				 const struct sstvenc_mode_plan* plan,
+				 const char*			 fsk_id,
+				 const uint8_t* framebuffer, double rise_time,
+				 double fall_time, uint8_t time_unit,
+				 uint8_t kernel) {
+	const uint32_t sample_rate = plan->sample_rate;
+
 	/* Initialise the data structures */
-	sstvenc_encoder_init(&(mod->enc), mode, fsk_id, framebuffer);
+	sstvenc_encoder_init_channels(&(mod->enc), plan->mode, fsk_id,
+				      framebuffer, plan->channel);
 	sstvenc_osc_init(&(mod->osc), 1.0, SSTVENC_FREQ_SYNC, 0.0,
-			 sample_rate);
+			 sample_rate, kernel);
 	sstvenc_ps_init(&(mod->ps), 1.0, rise_time, INFINITY, fall_time,
 			sample_rate, time_unit);
+	memcpy(mod->level_phase_inc, plan->level_phase_inc,
+	       sizeof(mod->level_phase_inc));
 
 	/* Clear the state machine */
+	sstvenc_ts_clock_init(&(mod->clock), sample_rate);
 	mod->total_samples = 0;
 	mod->total_ns	   = 0;
 	mod->remaining	   = 0;
 }
 
+uint64_t sstvenc_modulator_get_total_samples(
+    const struct sstvenc_mode* mode, const char* fsk_id, uint32_t sample_rate,
+    double rise_time, double fall_time, uint8_t time_unit) {
+	const uint64_t scale
+	    = sstvenc_ts_unit_scale(SSTVENC_TS_UNIT_NANOSECONDS);
+	struct sstvenc_pulseshape ps;
+	struct sstvenc_ts_clock	  clock;
+	uint64_t		  samples;
+
+	/*
+	 * The sample clock carries the fractional sample over from one pulse
+	 * to the next, so the pulses take as many samples in total as one
+	 * pulse lasting the whole transmission would.
+	 */
+	sstvenc_ts_clock_init(&clock, sample_rate);
+	samples = (clock.frac
+		   + (sstvenc_mode_get_txtime(mode, fsk_id) * sample_rate))
+		  / scale;
+
+	/* The carrier rises from zero then holds the sync frequency */
+	sstvenc_ps_init(&ps, 1.0, rise_time, INFINITY, fall_time, sample_rate,
+			time_unit);
+	samples += ps.rise_sz + 1;
+
+	/*
+	 * One sample is emitted on discovering the encoder has finished, and
+	 * another as the pulse shaper moves into the FALL phase.
+	 */
+	samples += 2;
+
+	/* The fall takes at least one sample, even if disabled */
+	if (ps.fall_sz) {
+		samples += ps.fall_sz;
+	} else {
+		samples++;
+	}
+
+	return samples;
+}
+
 /*!
  * Compute the next sample whilst in the RISE phase of the pulse shaper state
  * machine.
@@ -50,35 +129,32 @@ static void sstvenc_modulator_next_tone(struct sstvenc_mod* const mod) {
 
 		if (pulse) {
 			/* Update the oscillator frequency */
-			sstvenc_osc_set_frequency(&(mod->osc),
-						  pulse->frequency);
+			if (pulse->flags & SSTVENC_PULSE_FLAG_PIXEL) {
+				sstvenc_osc_set_phase_inc(
+				    &(mod->osc),
+				    mod->level_phase_inc[pulse->level]);
+			} else {
+				sstvenc_osc_set_frequency(&(mod->osc),
+							  pulse->frequency);
+			}
 
-			/* Figure out time duration in samples */
-			mod->remaining = sstvenc_ts_unit_to_samples(
-			    pulse->duration_ns, mod->osc.sample_rate,
-			    SSTVENC_TS_UNIT_NANOSECONDS);
+			/*
+			 * Figure out time duration in samples.  The clock
+			 * places the end of the pulse on the nearest sample,
+			 * so rounding errors do not accumulate.
+			 */
+			mod->remaining = sstvenc_ts_clock_advance(
+			    &(mod->clock), pulse->duration_ns);
 
 			/* Total up time and sample count */
 			mod->total_samples += mod->remaining;
 			mod->total_ns	   += pulse->duration_ns;
 
-			/* Sanity check timing, adjust for any
-			 * slippage */
-			uint64_t expected_total_samples
-			    = sstvenc_ts_unit_to_samples(
-				mod->total_ns, mod->osc.sample_rate,
-				SSTVENC_TS_UNIT_NANOSECONDS);
-			if (expected_total_samples > mod->total_samples) {
-				/*
-				 * Rounding error has caused a slip,
-				 * add samples to catch up.
-				 */
-				uint64_t diff = expected_total_samples
-						- mod->total_samples;
-				mod->remaining	   += diff;
-				mod->total_samples += diff;
+			if (mod->remaining) {
+				return;
 			}
-			return;
+
+			/* Pulse is shorter than a sample, skip it */
 		}
 	}
 }
@@ -144,11 +220,74 @@ void sstvenc_modulator_compute(struct sstvenc_mod* const mod) {
 	}
 }
 
+/*!
+ * Render a run of samples whilst in the HOLD phase of the pulse shaper state
+ * machine.  This produces the same output as repeated calls to
+ * @ref sstvenc_modulator_next_hold_sample, but emits the remainder of each
+ * pulse in one block as the frequency only changes at pulse boundaries.
+ *
+ * The end of the image is left to the per-sample code.
+ *
+ * @returns	Number of samples written to @a buffer.
+ */
+static size_t sstvenc_modulator_fill_hold(struct sstvenc_mod* const mod,
+					  double* buffer, size_t buffer_sz) {
+	size_t written_sz = 0;
+
+	while ((written_sz < buffer_sz)
+	       && (mod->enc.phase != SSTVENC_ENCODER_PHASE_DONE)) {
+		size_t run;
+
+		if (mod->remaining == 0) {
+			sstvenc_modulator_next_tone(mod);
+
+			if (mod->remaining == 0) {
+				/*
+				 * The encoder finished.  The per-sample code
+				 * repeats the last output for this sample.
+				 */
+				sstvenc_ps_compute(&(mod->ps));
+				mod->osc.amplitude = mod->ps.output;
+				buffer[written_sz] = mod->osc.output;
+				written_sz++;
+				break;
+			}
+		}
+
+		run = buffer_sz - written_sz;
+		if (run > mod->remaining) {
+			run = mod->remaining;
+		}
+
+		/* The pulse shaper holds at full amplitude indefinitely */
+		mod->ps.sample_idx += (uint32_t)run;
+		mod->ps.output	    = mod->ps.amplitude;
+		mod->osc.amplitude  = mod->ps.output;
+
+		sstvenc_osc_fill(&(mod->osc), buffer + written_sz, run);
+		mod->remaining -= (uint32_t)run;
+		written_sz     += run;
+	}
+
+	return written_sz;
+}
+
 size_t sstvenc_modulator_fill_buffer(struct sstvenc_mod* const mod,
 				     double* buffer, size_t buffer_sz) {
 	size_t written_sz = 0;
 
 	while ((buffer_sz > 0) && (mod->ps.phase < SSTVENC_PS_PHASE_DONE)) {
+		if ((mod->ps.phase == SSTVENC_PS_PHASE_HOLD)
+		    && (mod->enc.phase != SSTVENC_ENCODER_PHASE_DONE)) {
+			size_t sz = sstvenc_modulator_fill_hold(mod, buffer,
+								buffer_sz);
+
+			buffer	   += sz;
+			buffer_sz  -= sz;
+			written_sz += sz;
+			continue;
+		}
+
 		sstvenc_modulator_compute(mod);
 
 		buffer[0] = mod->osc.output;
@@ -161,6 +300,157 @@ size_t sstvenc_modulator_fill_buffer(struct sstvenc_mod* const mod,
 	return written_sz;
 }
 
+/*!
+ * Sample source for the narrow-format fill functions, see @ref sampfmt.
+ */
+static size_t sstvenc_modulator_source(void* ctx, double* buffer,
+				       size_t buffer_sz) {
+	return sstvenc_modulator_fill_buffer(ctx, buffer, buffer_sz);
+}
+
+size_t sstvenc_modulator_fill_buffer_f32(struct sstvenc_mod* const mod,
+					 float* buffer, size_t buffer_sz) {
+	return sstvenc_sampfmt_fill_f32(buffer, buffer_sz,
+					sstvenc_modulator_source, mod);
+}
+
+size_t sstvenc_modulator_fill_s16(struct sstvenc_mod* const mod,
+				  int16_t* buffer, size_t buffer_sz,
+				  uint8_t endianness) {
+	return sstvenc_sampfmt_fill_s16(buffer, buffer_sz, endianness,
+					sstvenc_modulator_source, mod);
+}
+
+/*!
+ * Return the modulator to the start of its transmission, keeping the
+ * settings it was initialised with.
+ */
+static void sstvenc_modulator_rewind(struct sstvenc_mod* const mod) {
+	struct sstvenc_encoder_channel channel[4];
+
+	memcpy(channel, mod->enc.channel, sizeof(channel));
+	sstvenc_encoder_init_channels(&(mod->enc), mod->enc.mode,
+				      mod->enc.fsk_id, mod->enc.framebuffer,
+				      channel);
+	sstvenc_osc_init(&(mod->osc), 1.0, SSTVENC_FREQ_SYNC, mod->osc.offset,
+			 mod->osc.sample_rate, mod->osc.kernel);
+	sstvenc_ps_reset_samples(&(mod->ps), mod->ps.hold_sz);
+	mod->ps.output = 0.0;
+
+	sstvenc_ts_clock_init(&(mod->clock), mod->osc.sample_rate);
+	mod->total_samples = 0;
+	mod->total_ns	   = 0;
+	mod->remaining	   = 0;
+}
+
+uint64_t sstvenc_modulator_seek(struct sstvenc_mod* const mod,
+				uint64_t		  sample_idx) {
+	sstvenc_modulator_rewind(mod);
+	return sstvenc_modulator_skip(mod, sample_idx);
+}
+
+uint64_t sstvenc_modulator_skip(struct sstvenc_mod* const mod,
+				uint64_t		  samples) {
+	uint64_t posn = 0;
+
+	/* The carrier rise is computed sample by sample */
+	while ((posn < samples)
+	       && (mod->ps.phase < SSTVENC_PS_PHASE_HOLD)) {
+		sstvenc_modulator_compute(mod);
+		posn++;
+	}
+
+	/* Skip over whole pulses whilst the carrier is held */
+	while ((posn < samples) && (mod->ps.phase == SSTVENC_PS_PHASE_HOLD)
+	       && (mod->enc.phase != SSTVENC_ENCODER_PHASE_DONE)) {
+		uint64_t run;
+
+		if (mod->remaining == 0) {
+			sstvenc_modulator_next_tone(mod);
+
+			if (mod->remaining == 0) {
+				/* As for sstvenc_modulator_fill_hold */
+				sstvenc_ps_compute(&(mod->ps));
+				mod->osc.amplitude = mod->ps.output;
+				posn++;
+				break;
+			}
+		}
+
+		run = samples - posn;
+		if (run > mod->remaining) {
+			run = mod->remaining;
+		}
+
+		mod->ps.sample_idx += (uint32_t)run;
+		mod->ps.output	    = mod->ps.amplitude;
+		mod->osc.amplitude  = mod->ps.output;
+
+		/* Compute the last sample so the output is correct */
+		sstvenc_osc_skip(&(mod->osc), run - 1);
+		sstvenc_osc_compute(&(mod->osc));
+		mod->remaining -= (uint32_t)run;
+		posn	       += run;
+	}
+
+	/* The end of the image and the carrier fall */
+	while ((posn < samples)
+	       && (mod->ps.phase < SSTVENC_PS_PHASE_DONE)) {
+		sstvenc_modulator_compute(mod);
+		posn++;
+	}
+
+	return posn;
+}
+
+void sstvenc_modulator_snapshot(const struct sstvenc_mod* const mod,
+				struct sstvenc_mod_snapshot* const snap) {
+	sstvenc_encoder_snapshot(&(mod->enc), &(snap->enc));
+	snap->total_samples = mod->total_samples;
+	snap->total_ns	    = mod->total_ns;
+	snap->clock_frac    = mod->clock.frac;
+	snap->osc_amplitude = mod->osc.amplitude;
+	snap->osc_output    = mod->osc.output;
+	snap->ps_output	    = mod->ps.output;
+	snap->osc_phase	    = mod->osc.phase;
+	snap->osc_phase_inc = mod->osc.phase_inc;
+	snap->ps_sample_idx = mod->ps.sample_idx;
+	snap->remaining	    = mod->remaining;
+	snap->sample_rate   = mod->osc.sample_rate;
+	snap->ps_phase	    = mod->ps.phase;
+}
+
+int sstvenc_modulator_restore(struct sstvenc_mod* const		 mod,
+			      const struct sstvenc_mod_snapshot* snap) {
+	int res;
+
+	if ((snap->sample_rate != mod->osc.sample_rate)
+	    || (snap->ps_phase > SSTVENC_PS_PHASE_DONE)) {
+		return -EINVAL;
+	}
+
+	res = sstvenc_encoder_restore(&(mod->enc), &(snap->enc));
+	if (res < 0) {
+		return res;
+	}
+
+	mod->total_samples = snap->total_samples;
+	mod->total_ns	   = snap->total_ns;
+	mod->clock.frac	   = snap->clock_frac;
+	mod->osc.amplitude = snap->osc_amplitude;
+	mod->osc.output	   = snap->osc_output;
+	mod->osc.phase	   = snap->osc_phase;
+	mod->ps.output	   = snap->ps_output;
+	mod->ps.sample_idx = snap->ps_sample_idx;
+	mod->ps.phase	   = snap->ps_phase;
+	mod->remaining	   = snap->remaining;
+	sstvenc_osc_set_phase_inc(&(mod->osc), snap->osc_phase_inc);
+
+	/* Pick the phasor up from the restored phase */
+	sstvenc_osc_skip(&(mod->osc), 0);
+	return 0;
+}
+
 /*!
  * @}
  */
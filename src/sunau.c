@@ -17,10 +17,23 @@
 /*!
  * Size of a Sun Audio header in 32-bit words.
  */
-#define SSTVENC_SUNAU_HEADER_SZ (7)
+#define SSTVENC_SUNAU_HEADER_SZ	     (7)
+
+/*!
+ * Size of the Sun Audio header written to memory-mapped files in 32-bit
+ * words.  The annotation is padded out to 8 bytes so the sample data is
+ * 8-byte aligned.
+ */
+#define SSTVENC_SUNAU_MMAP_HEADER_SZ (8)
 
 #include <assert.h>
+#include <fcntl.h>
+#include <libsstvenc/sampfmt.h>
 #include <libsstvenc/sunau.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #ifdef MISSING_ENDIAN_H
 /*
@@ -28,20 +41,8 @@
  * https://pubs.opengroup.org/onlinepubs/9799919799/basedefs/endian.h.html
  */
 #include <arpa/inet.h>
-static uint16_t be16toh(uint16_t in) { return ntohs(in); }
-static uint16_t htobe16(uint16_t in) { return htons(in); }
-
 static uint32_t be32toh(uint32_t in) { return ntohl(in); }
 static uint32_t htobe32(uint32_t in) { return htonl(in); }
-
-static uint64_t be64toh(uint64_t in) {
-	return ((uint64_t)((((uint64_t)ntohl(in >> 32)) << 32)
-			   | ntohl(in & UINT32_MAX)));
-}
-static uint64_t htobe64(uint64_t in) {
-	return ((uint64_t)((((uint64_t)htonl(in >> 32)) << 32)
-			   | htonl(in & UINT32_MAX)));
-}
 #else
 #include <endian.h>
 #endif
@@ -49,52 +50,14 @@ static uint64_t htobe64(uint64_t in) {
 /*! SunAU encoder state bit: header is written */
 #define SSTVENC_SUNAU_STATE_HEADER (0x0001)
 
-/*! SunAU decoder state bit: end of file has been reached */
-#define SSTVENC_SUNAU_STATE_EOF	   (0x8000)
+/*! SunAU state bit: the file is memory-mapped */
+#define SSTVENC_SUNAU_STATE_MMAP   (0x0002)
 
-/*! Convert a 32-bit IEEE-754 float to big-endian */
-static uint32_t fhtobe32(float in) {
-	union {
-		float	 f;
-		uint32_t ui;
-	} tmp;
-
-	tmp.f = in;
-	return htobe32(tmp.ui);
-}
+/*! SunAU encoder state bit: streaming, the file is never seeked */
+#define SSTVENC_SUNAU_STATE_STREAM (0x0004)
 
-/*! Convert a 32-bit IEEE-754 float from big-endian */
-static float fbe32toh(uint32_t in) {
-	union {
-		float	 f;
-		uint32_t ui;
-	} tmp;
-
-	tmp.ui = be32toh(in);
-	return be32toh(tmp.f);
-}
-
-/*! Convert a 64-bit IEEE-754 float to big-endian */
-static uint64_t dhtobe64(double in) {
-	union {
-		double	 f;
-		uint64_t ui;
-	} tmp;
-
-	tmp.f = in;
-	return htobe64(tmp.ui);
-}
-
-/*! Convert a 64-bit IEEE-754 float from big-endian */
-static double dbe64toh(uint64_t in) {
-	union {
-		double	 f;
-		uint64_t ui;
-	} tmp;
-
-	tmp.ui = be64toh(in);
-	return be64toh(tmp.f);
-}
+/*! SunAU decoder state bit: end of file has been reached */
+#define SSTVENC_SUNAU_STATE_EOF	   (0x8000)
 
 /*!
  * Initialise the audio source ready for reading samples.  The
@@ -179,7 +142,7 @@ static int sstvenc_sunau_enc_write_header(struct sstvenc_sunau* const enc) {
 	uint32_t hdr[SSTVENC_SUNAU_HEADER_SZ] = {
 	    SSTVENC_SUNAU_MAGIC, // Magic ".snd"
 	    sizeof(hdr),	 // Data offset: 28 bytes (7*4-bytes)
-	    UINT32_MAX,		 // Data size: unknown for now
+	    enc->data_sz,	 // Data size: unknown unless streaming
 	    enc->encoding,	 // Encoding: int16_t linear
 	    enc->sample_rate,	 // Sample rate
 	    enc->channels,	 // Channels
@@ -208,120 +171,78 @@ static int sstvenc_sunau_enc_write_header(struct sstvenc_sunau* const enc) {
 }
 
 /*!
- * Write the given samples in signed 8-bit integer format.
- */
-static int sstvenc_sunau_write_s8(struct sstvenc_sunau* const enc,
-				  size_t n_sample, const double* sample) {
-	/* Scale to 8-bit fixed-point */
-	int8_t isample[n_sample];
-	int    i;
-
-	for (i = 0; i < n_sample; i++) {
-		/* Scale */
-		isample[i] = INT8_MAX * sample[i];
-	}
-
-	size_t sz = fwrite(isample, n_sample, sizeof(int8_t), enc->fh);
-	if (sz < n_sample) {
-		return -errno;
-	} else {
-		enc->written_sz += sz * sizeof(int8_t);
-		return 0;
-	}
-}
-
-/*!
- * Write the given samples in signed 16-bit integer format.
- */
-static int sstvenc_sunau_write_s16(struct sstvenc_sunau* const enc,
-				   size_t n_sample, const double* sample) {
-	/* Scale to 16-bit fixed-point */
-	int16_t isample[n_sample];
-	int	i;
-
-	for (i = 0; i < n_sample; i++) {
-		/* Scale */
-		isample[i] = INT16_MAX * sample[i];
-		/* Byte swap */
-		isample[i] = htobe16(isample[i]);
-	}
-
-	size_t sz = fwrite(isample, n_sample, sizeof(int16_t), enc->fh);
-	if (sz < n_sample) {
-		return -errno;
-	} else {
-		enc->written_sz += sz * sizeof(int16_t);
-		return 0;
-	}
-}
-
-/*!
- * Write the given samples in signed 32-bit integer format.
+ * Convert the given samples to the file's encoding.
+ *
+ * @param[in]		enc		SunAU encoder context
+ * @param[out]		out		Output, room for @a n_sample samples
+ * @param[in]		n_sample	Number of samples to convert
+ * @param[in]		sample		Samples to convert
  */
-static int sstvenc_sunau_write_s32(struct sstvenc_sunau* const enc,
-				   size_t n_sample, const double* sample) {
-	/* Scale to 32-bit fixed-point */
-	int32_t isample[n_sample];
-	int	i;
-
-	for (i = 0; i < n_sample; i++) {
-		/* Scale */
-		isample[i] = INT32_MAX * sample[i];
-		/* Byte swap */
-		isample[i] = htobe32(isample[i]);
-	}
-
-	size_t sz = fwrite(isample, n_sample, sizeof(int32_t), enc->fh);
-	if (sz < n_sample) {
-		return -errno;
-	} else {
-		enc->written_sz += sz * sizeof(int32_t);
-		return 0;
+static void sstvenc_sunau_conv(const struct sstvenc_sunau* const enc,
+			       void* out, size_t n_sample,
+			       const double* sample) {
+	switch (enc->encoding) {
+	case SSTVENC_SUNAU_FMT_S8:
+		sstvenc_sampfmt_f64_to_s8(out, sample, n_sample);
+		break;
+	case SSTVENC_SUNAU_FMT_S16:
+		sstvenc_sampfmt_f64_to_s16(out, sample, n_sample,
+					   SSTVENC_SAMPFMT_ENDIAN_BIG);
+		break;
+	case SSTVENC_SUNAU_FMT_S32:
+		sstvenc_sampfmt_f64_to_s32(out, sample, n_sample,
+					   SSTVENC_SAMPFMT_ENDIAN_BIG);
+		break;
+	case SSTVENC_SUNAU_FMT_F32:
+		sstvenc_sampfmt_f64_to_f32be(out, sample, n_sample);
+		break;
+	case SSTVENC_SUNAU_FMT_F64:
+		sstvenc_sampfmt_f64_to_f64be(out, sample, n_sample);
+		break;
+	default:
+		assert(0);
 	}
 }
 
 /*!
- * Write the given samples in 32-bit IEEE-754 floating-point format.
+ * Return the size of one sample in the file's encoding, in bytes.
  */
-static int sstvenc_sunau_write_f32(struct sstvenc_sunau* const enc,
-				   size_t n_sample, const double* sample) {
-	/* Convert to big-endian float */
-	int32_t fsample[n_sample];
-	int	i;
-
-	for (i = 0; i < n_sample; i++) {
-		/* Byte swap */
-		fsample[i] = fhtobe32(sample[i]);
-	}
-
-	size_t sz = fwrite(fsample, n_sample, sizeof(int32_t), enc->fh);
-	if (sz < n_sample) {
-		return -errno;
-	} else {
-		enc->written_sz += sz * sizeof(int32_t);
+static size_t sstvenc_sunau_sample_sz(const struct sstvenc_sunau* const enc) {
+	switch (enc->encoding) {
+	case SSTVENC_SUNAU_FMT_S8:
+		return sizeof(int8_t);
+	case SSTVENC_SUNAU_FMT_S16:
+		return sizeof(int16_t);
+	case SSTVENC_SUNAU_FMT_S32:
+		return sizeof(int32_t);
+	case SSTVENC_SUNAU_FMT_F32:
+		return sizeof(float);
+	case SSTVENC_SUNAU_FMT_F64:
+		return sizeof(double);
+	default:
+		assert(0);
 		return 0;
 	}
 }
 
 /*!
- * Write the given samples in 64-bit IEEE-754 floating-point format.
+ * Write converted sample data to the file.
+ *
+ * @param[inout]	enc		SunAU encoder context
+ * @param[in]		data		Converted samples
+ * @param[in]		data_sz		Size of @a data in bytes
+ *
+ * @retval		0		Success
+ * @retval		<0		Write error `errno` from `fwrite()`
  */
-static int sstvenc_sunau_write_f64(struct sstvenc_sunau* const enc,
-				   size_t n_sample, const double* sample) {
-	/* Convert to big-endian float */
-	int64_t fsample[n_sample];
-	int	i;
-
-	for (i = 0; i < n_sample; i++) {
-		/* Byte swap */
-		fsample[i] = dhtobe64(sample[i]);
-	}
-
-	size_t sz = fwrite(fsample, n_sample, sizeof(int64_t), enc->fh);
-	if (sz < n_sample) {
-		return -errno;
+static int sstvenc_sunau_enc_put(struct sstvenc_sunau* const enc,
+				 const void* data, size_t data_sz) {
+	errno	  = 0;
+	size_t sz = fwrite(data, 1, data_sz, enc->fh);
+	enc->written_sz += sz;
+	if (sz < data_sz) {
+		return errno ? -errno : -EIO;
 	} else {
-		enc->written_sz += sz * sizeof(int64_t);
 		return 0;
 	}
 }
@@ -355,7 +276,12 @@ int sstvenc_sunau_enc_init_fh(struct sstvenc_sunau* const enc, FILE* fh,
 	}
 
 	enc->fh		 = fh;
+	enc->buffer	 = NULL;
+	enc->buffer_sz	 = 0;
+	enc->buffer_len	 = 0;
+	enc->fd		 = -1;
 	enc->written_sz	 = 0;
+	enc->data_sz	 = UINT32_MAX;
 	enc->state	 = 0;
 	enc->sample_rate = sample_rate;
 	enc->encoding	 = encoding;
@@ -377,7 +303,12 @@ int sstvenc_sunau_enc_init(struct sstvenc_sunau* const enc, const char* path,
 		return -errno;
 	}
 
+	enc->buffer	 = NULL;
+	enc->buffer_sz	 = 0;
+	enc->buffer_len	 = 0;
+	enc->fd		 = -1;
 	enc->written_sz	 = 0;
+	enc->data_sz	 = UINT32_MAX;
 	enc->state	 = 0;
 	enc->sample_rate = sample_rate;
 	enc->encoding	 = encoding;
@@ -386,12 +317,174 @@ int sstvenc_sunau_enc_init(struct sstvenc_sunau* const enc, const char* path,
 	return 0;
 }
 
+int sstvenc_sunau_enc_init_stream(struct sstvenc_sunau* const enc,
+				  FILE* fh, uint32_t sample_rate,
+				  uint8_t encoding, uint8_t channels,
+				  size_t n_samples) {
+	int res = sstvenc_sunau_enc_init_fh(enc, fh, sample_rate, encoding,
+					    channels);
+	if (res < 0) {
+		return res;
+	}
+
+	if (n_samples != SSTVENC_SUNAU_SIZE_UNKNOWN) {
+		const size_t sample_sz = sstvenc_sunau_sample_sz(enc);
+
+		if ((n_samples % channels) != 0) {
+			return -EINVAL;
+		}
+
+		if (n_samples >= (UINT32_MAX / sample_sz)) {
+			/* Will not fit in the 32-bit data size field */
+			return -EFBIG;
+		}
+
+		enc->data_sz = n_samples * sample_sz;
+	}
+
+	enc->state = SSTVENC_SUNAU_STATE_STREAM;
+	return 0;
+}
+
+int sstvenc_sunau_enc_init_mmap(struct sstvenc_sunau* const enc,
+				const char* path, uint32_t sample_rate,
+				uint8_t encoding, uint8_t channels,
+				size_t n_samples) {
+	int res = sstvenc_sunau_check(sample_rate, encoding, channels);
+	if (res < 0) {
+		return res;
+	}
+
+	if ((n_samples % channels) != 0) {
+		return -EINVAL;
+	}
+
+	enc->encoding = encoding;
+
+	const size_t sample_sz = sstvenc_sunau_sample_sz(enc);
+	const size_t hdr_sz    = SSTVENC_SUNAU_MMAP_HEADER_SZ * 4;
+	const size_t data_sz   = n_samples * sample_sz;
+	if ((data_sz / sample_sz) != n_samples
+	    || (data_sz > (UINT32_MAX - hdr_sz))) {
+		/* Will not fit in the 32-bit data size field */
+		return -EFBIG;
+	}
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	/* Size the file, then try to reserve the space for it */
+	if (ftruncate(fd, hdr_sz + data_sz) < 0) {
+		res = -errno;
+		goto fail;
+	}
+
+#ifndef MISSING_POSIX_FALLOCATE
+	res = posix_fallocate(fd, 0, hdr_sz + data_sz);
+	if ((res != 0) && (res != EINVAL) && (res != EOPNOTSUPP)) {
+		/* Not enough space (EINVAL et al: not supported here) */
+		res = -res;
+		goto fail;
+	}
+#endif
+
+	uint8_t* map = mmap(NULL, hdr_sz + data_sz, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		res = -errno;
+		goto fail;
+	}
+
+	uint32_t hdr[SSTVENC_SUNAU_MMAP_HEADER_SZ] = {
+	    SSTVENC_SUNAU_MAGIC, // Magic ".snd"
+	    sizeof(hdr),	 // Data offset: 32 bytes (8*4-bytes)
+	    data_sz,		 // Data size: known up front
+	    encoding,		 // Encoding
+	    sample_rate,	 // Sample rate
+	    channels,		 // Channels
+	    0,			 // Annotation (unused)
+	    0,			 // Annotation padding
+	};
+
+	for (int i = 0; i < SSTVENC_SUNAU_MMAP_HEADER_SZ; i++) {
+		/* Byte swap to big-endian */
+		hdr[i] = htobe32(hdr[i]);
+	}
+	memcpy(map, hdr, sizeof(hdr));
+
+	enc->fh		 = NULL;
+	enc->buffer	 = map + hdr_sz;
+	enc->buffer_sz	 = data_sz;
+	enc->buffer_len	 = 0;
+	enc->fd		 = fd;
+	enc->written_sz	 = 0;
+	enc->data_sz	 = data_sz;
+	enc->state	 = SSTVENC_SUNAU_STATE_HEADER;
+	enc->state	|= SSTVENC_SUNAU_STATE_MMAP;
+	enc->sample_rate = sample_rate;
+	enc->channels	 = channels;
+
+	return 0;
+
+fail:
+	/* Don't leave a full-size file of silence behind */
+	unlink(path);
+	close(fd);
+	return res;
+}
+
+int sstvenc_sunau_enc_set_buffer(struct sstvenc_sunau* const enc,
+				 void* buffer, size_t buffer_sz) {
+	if (enc->state & SSTVENC_SUNAU_STATE_MMAP) {
+		/* The buffer is the mapped file */
+		return -EINVAL;
+	}
+
+	if (buffer && (buffer_sz < sstvenc_sunau_sample_sz(enc))) {
+		return -EINVAL;
+	}
+
+	int res = sstvenc_sunau_enc_flush(enc);
+	if (res < 0) {
+		return res;
+	}
+
+	enc->buffer	= buffer;
+	enc->buffer_sz	= buffer ? buffer_sz : 0;
+	enc->buffer_len = 0;
+	return 0;
+}
+
+int sstvenc_sunau_enc_flush(struct sstvenc_sunau* const enc) {
+	if ((enc->state & SSTVENC_SUNAU_STATE_MMAP) || !enc->buffer_len) {
+		/* Nothing to write out */
+		return 0;
+	}
+
+	int res = sstvenc_sunau_enc_put(enc, enc->buffer, enc->buffer_len);
+
+	enc->buffer_len = 0;
+	return res;
+}
+
 int sstvenc_sunau_enc_write(struct sstvenc_sunau* const enc, size_t n_samples,
 			    const double* samples) {
+	const size_t sample_sz = sstvenc_sunau_sample_sz(enc);
+
 	if ((n_samples % enc->channels) != 0) {
 		return -EINVAL;
 	}
 
+	if ((enc->state & SSTVENC_SUNAU_STATE_STREAM)
+	    && (enc->data_sz != UINT32_MAX)
+	    && ((n_samples * sample_sz)
+		> (enc->data_sz - enc->written_sz - enc->buffer_len))) {
+		/* This would run past the size given in the header */
+		return -ENOSPC;
+	}
+
 	if (!(enc->state & SSTVENC_SUNAU_STATE_HEADER)) {
 		int res = sstvenc_sunau_enc_write_header(enc);
 		if (res < 0) {
@@ -399,24 +492,127 @@ int sstvenc_sunau_enc_write(struct sstvenc_sunau* const enc, size_t n_samples,
 		}
 	}
 
-	switch (enc->encoding) {
-	case SSTVENC_SUNAU_FMT_S8:
-		return sstvenc_sunau_write_s8(enc, n_samples, samples);
-	case SSTVENC_SUNAU_FMT_S16:
-		return sstvenc_sunau_write_s16(enc, n_samples, samples);
-	case SSTVENC_SUNAU_FMT_S32:
-		return sstvenc_sunau_write_s32(enc, n_samples, samples);
-	case SSTVENC_SUNAU_FMT_F32:
-		return sstvenc_sunau_write_f32(enc, n_samples, samples);
-	case SSTVENC_SUNAU_FMT_F64:
-		return sstvenc_sunau_write_f64(enc, n_samples, samples);
-	default:
-		assert(0);
-		return -EINVAL;
+	if (!enc->buffer) {
+		/* Convert a block at a time and write each one out */
+		uint64_t block[SSTVENC_SUNAU_BLOCK_SZ];
+
+		while (n_samples) {
+			size_t sz = n_samples;
+			if (sz > SSTVENC_SUNAU_BLOCK_SZ) {
+				sz = SSTVENC_SUNAU_BLOCK_SZ;
+			}
+
+			sstvenc_sunau_conv(enc, block, sz, samples);
+			int res = sstvenc_sunau_enc_put(enc, block,
+							sz * sample_sz);
+			if (res < 0) {
+				return res;
+			}
+
+			samples	  += sz;
+			n_samples -= sz;
+		}
+
+		return 0;
+	}
+
+	while (n_samples) {
+		/* Convert as much as will fit straight into the buffer */
+		size_t sz = (enc->buffer_sz - enc->buffer_len) / sample_sz;
+		if (!sz) {
+			if (enc->state & SSTVENC_SUNAU_STATE_MMAP) {
+				/* The mapped file is full */
+				return -ENOSPC;
+			}
+
+			int res = sstvenc_sunau_enc_flush(enc);
+			if (res < 0) {
+				return res;
+			}
+			continue;
+		}
+
+		if (sz > n_samples) {
+			sz = n_samples;
+		}
+
+		sstvenc_sunau_conv(enc, enc->buffer + enc->buffer_len, sz,
+				   samples);
+		enc->buffer_len += sz * sample_sz;
+		samples		+= sz;
+		n_samples	-= sz;
+	}
+
+	return 0;
+}
+
+/*!
+ * Unmap and close a memory-mapped file.  If fewer samples were written than
+ * the file was sized for, the header and file are cut down to fit.
+ */
+static int sstvenc_sunau_enc_close_mmap(struct sstvenc_sunau* const enc) {
+	const size_t hdr_sz = SSTVENC_SUNAU_MMAP_HEADER_SZ * 4;
+	uint8_t*     map    = enc->buffer - hdr_sz;
+	int	     res    = 0;
+
+	if (enc->buffer_len < enc->buffer_sz) {
+		/* Correct the data size in the header */
+		uint32_t data_sz = htobe32(enc->buffer_len);
+		memcpy(map + (sizeof(uint32_t) * 2), &data_sz,
+		       sizeof(data_sz));
+	}
+
+	if (munmap(map, hdr_sz + enc->buffer_sz) < 0) {
+		res = -errno;
+	}
+
+	if ((res == 0) && (enc->buffer_len < enc->buffer_sz)
+	    && (ftruncate(enc->fd, hdr_sz + enc->buffer_len) < 0)) {
+		res = -errno;
+	}
+
+	if ((close(enc->fd) < 0) && (res == 0)) {
+		res = -errno;
+	}
+
+	enc->written_sz = enc->buffer_len;
+	enc->buffer	= NULL;
+	enc->fd		= -1;
+	return res;
+}
+
+/*!
+ * Pad a streamed file out to the data size given in its header with
+ * silence.  Zero is all-bits-zero in every supported encoding.
+ *
+ * @param[inout]	enc		SunAU encoder context
+ *
+ * @retval		0		Success
+ * @retval		<0		Write error `errno` from `fwrite()`
+ */
+static int sstvenc_sunau_enc_pad(struct sstvenc_sunau* const enc) {
+	static const uint64_t silence[SSTVENC_SUNAU_BLOCK_SZ];
+
+	while (enc->written_sz < enc->data_sz) {
+		size_t sz = enc->data_sz - enc->written_sz;
+		if (sz > sizeof(silence)) {
+			sz = sizeof(silence);
+		}
+
+		int res = sstvenc_sunau_enc_put(enc, silence, sz);
+		if (res < 0) {
+			return res;
+		}
 	}
+
+	return 0;
 }
 
 int sstvenc_sunau_enc_close(struct sstvenc_sunau* const enc) {
+	if (enc->state & SSTVENC_SUNAU_STATE_MMAP) {
+		return sstvenc_sunau_enc_close_mmap(enc);
+	}
+
 	if (!(enc->state & SSTVENC_SUNAU_STATE_HEADER)) {
 		int res = sstvenc_sunau_enc_write_header(enc);
 		if (res < 0) {
@@ -424,8 +620,24 @@ int sstvenc_sunau_enc_close(struct sstvenc_sunau* const enc) {
 		}
 	}
 
-	/* Can we seek in this file? */
-	if (fseek(enc->fh, sizeof(uint32_t) * 2, SEEK_SET) == 0) {
+	{
+		int res = sstvenc_sunau_enc_flush(enc);
+		if ((res == 0) && (enc->state & SSTVENC_SUNAU_STATE_STREAM)
+		    && (enc->data_sz != UINT32_MAX)) {
+			/* Make good on the size we promised */
+			res = sstvenc_sunau_enc_pad(enc);
+		}
+
+		if (res < 0) {
+			/* Write failed, close and bail! */
+			fclose(enc->fh);
+			return res;
+		}
+	}
+
+	/* Can we seek in this file?  (Don't try if streaming) */
+	if (!(enc->state & SSTVENC_SUNAU_STATE_STREAM)
+	    && (fseek(enc->fh, sizeof(uint32_t) * 2, SEEK_SET) == 0)) {
 		/* We can, write out the *correct* file size */
 		uint32_t data_sz = htobe32(enc->written_sz);
 		size_t	 res = fwrite(&data_sz, 1, sizeof(uint32_t), enc->fh);
@@ -446,15 +658,20 @@ int sstvenc_sunau_enc_close(struct sstvenc_sunau* const enc) {
 	}
 }
 
-int sstvenc_sunau_dec_init_fh(struct sstvenc_sunau* const dec, FILE* fh) {
-	uint32_t hdr[SSTVENC_SUNAU_HEADER_SZ];
-	int	 res = 0;
-
-	if (fread(hdr, sizeof(hdr), 1, fh) < 1) {
-		/* Incomplete or failed read */
-		return -errno;
-	}
-
+/*!
+ * Parse and validate a Sun Audio header read from a file, filling in the
+ * decoder fields it describes.
+ *
+ * @param[out]		dec		SunAU decoder context
+ * @param[inout]	hdr		Raw header, converted to host-endian
+ * 					in place.
+ *
+ * @retval		0		Success
+ * @retval		-EINVAL		Not a Sun Audio file, or an
+ * 					unsupported format
+ */
+static int sstvenc_sunau_dec_parse_header(struct sstvenc_sunau* const dec,
+					  uint32_t*			hdr) {
 	/* Convert to host-endian format */
 	for (uint8_t i = 0; i < SSTVENC_SUNAU_HEADER_SZ; i++) {
 		hdr[i] = be32toh(hdr[i]);
@@ -472,8 +689,20 @@ int sstvenc_sunau_dec_init_fh(struct sstvenc_sunau* const dec, FILE* fh) {
 	dec->channels	 = hdr[5];
 
 	/* Check these are supported */
-	res = sstvenc_sunau_check(dec->sample_rate, dec->encoding,
-				  dec->channels);
+	return sstvenc_sunau_check(dec->sample_rate, dec->encoding,
+				   dec->channels);
+}
+
+int sstvenc_sunau_dec_init_fh(struct sstvenc_sunau* const dec, FILE* fh) {
+	uint32_t hdr[SSTVENC_SUNAU_HEADER_SZ];
+	int	 res = 0;
+
+	if (fread(hdr, sizeof(hdr), 1, fh) < 1) {
+		/* Incomplete or failed read */
+		return -errno;
+	}
+
+	res = sstvenc_sunau_dec_parse_header(dec, hdr);
 	if (res < 0) {
 		return res;
 	}
@@ -486,7 +715,12 @@ int sstvenc_sunau_dec_init_fh(struct sstvenc_sunau* const dec, FILE* fh) {
 
 	/* All ready */
 	dec->fh		= fh;
+	dec->buffer	= NULL;
+	dec->buffer_sz	= 0;
+	dec->buffer_len = 0;
+	dec->fd		= -1;
 	dec->written_sz = hdr[1];
+	dec->data_sz	= hdr[2];
 	dec->state	= 0;
 	return 0;
 }
@@ -507,205 +741,218 @@ int sstvenc_sunau_dec_init(struct sstvenc_sunau* const dec,
 	return res;
 }
 
-int sstvenc_sunau_dec_reset(struct sstvenc_sunau* const dec) {
-	if (fseek(dec->fh, dec->written_sz, SEEK_SET) < 0) {
-		/* Seek failed */
+int sstvenc_sunau_dec_init_mmap(struct sstvenc_sunau* const dec,
+				const char*		    path) {
+	uint32_t    hdr[SSTVENC_SUNAU_HEADER_SZ];
+	struct stat st;
+	int	    res = 0;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
 		return -errno;
-	} else {
-		/* Clear the EOF bit, as we should be back at the start */
-		dec->state &= ~SSTVENC_SUNAU_STATE_EOF;
-		return 0;
 	}
-}
 
-static int sstvenc_sunau_read_s8(struct sstvenc_sunau* const dec,
-				 size_t* const n_samples, double* samples) {
-	/* Use the end of the output buffer as scratch space. */
-	int8_t* in_buffer = (int8_t*)(&(samples[*n_samples]))
-			    - (sizeof(int8_t) * (*n_samples));
-	size_t in_buffer_sz = *n_samples;
-	size_t read_sz	    = 0;
-
-	/* Read the raw audio data */
-	errno		    = 0;
-	read_sz = fread(in_buffer, sizeof(int8_t), in_buffer_sz, dec->fh);
-	if (read_sz < in_buffer_sz) {
-		/* Short read, check for read errors */
-		if (errno != 0) {
-			return -errno;
-		} else {
-			dec->state |= SSTVENC_SUNAU_STATE_EOF;
-		}
+	if (fstat(fd, &st) < 0) {
+		res = -errno;
+		goto out;
 	}
 
-	/* Read is successful, write sample count, convert samples to
-	 * double-precision float */
-	*n_samples = read_sz;
-	while (read_sz) {
-		*samples = -(double)(*in_buffer) / (double)INT8_MIN;
-		samples++;
-		in_buffer++;
-		read_sz--;
+	ssize_t read_sz = pread(fd, hdr, sizeof(hdr), 0);
+	if (read_sz < 0) {
+		res = -errno;
+		goto out;
+	} else if ((size_t)read_sz < sizeof(hdr)) {
+		/* Too short to be a Sun Audio file */
+		res = -EINVAL;
+		goto out;
 	}
 
-	return 0;
-}
-
-static int sstvenc_sunau_read_s16(struct sstvenc_sunau* const dec,
-				  size_t* const n_samples, double* samples) {
-	/* Use the end of the output buffer as scratch space. */
-	int16_t* in_buffer = (int16_t*)(&(samples[*n_samples]))
-			     - (sizeof(int16_t) * (*n_samples));
-	size_t in_buffer_sz = *n_samples;
-	size_t read_sz	    = 0;
-
-	/* Read the raw audio data */
-	errno		    = 0;
-	read_sz = fread(in_buffer, sizeof(int16_t), in_buffer_sz, dec->fh);
-	if (read_sz < in_buffer_sz) {
-		/* Short read, check for read errors */
-		if (errno != 0) {
-			return -errno;
-		} else {
-			dec->state |= SSTVENC_SUNAU_STATE_EOF;
-		}
+	res = sstvenc_sunau_dec_parse_header(dec, hdr);
+	if (res < 0) {
+		goto out;
 	}
 
-	/* Read is successful, write sample count, convert samples to
-	 * double-precision float */
-	*n_samples = read_sz;
-	while (read_sz) {
-		int16_t host_endian = be16toh(*in_buffer);
-
-		*samples = -(double)(host_endian) / (double)INT16_MIN;
-		samples++;
-		in_buffer++;
-		read_sz--;
+	if (!S_ISREG(st.st_mode) || (hdr[1] < sizeof(hdr))
+	    || (hdr[1] > (uint64_t)st.st_size)) {
+		/* Not a mappable file, or the data offset is bogus */
+		res = -EINVAL;
+		goto out;
 	}
 
-	return 0;
-}
+	/*
+	 * Map the data region, which runs to the end of the file if the
+	 * size is unknown (all ones) or overstated.  Partial samples at the
+	 * end are ignored.
+	 */
+	const size_t sample_sz = sstvenc_sunau_sample_sz(dec);
+	uint64_t     data_sz   = (uint64_t)st.st_size - hdr[1];
+	if (hdr[2] < data_sz) {
+		data_sz = hdr[2];
+	}
+	data_sz -= data_sz % sample_sz;
 
-static int sstvenc_sunau_read_s32(struct sstvenc_sunau* const dec,
-				  size_t* const n_samples, double* samples) {
-	/* Use the end of the output buffer as scratch space. */
-	int32_t* in_buffer = (int32_t*)(&(samples[*n_samples]))
-			     - (sizeof(int32_t) * (*n_samples));
-	size_t in_buffer_sz = *n_samples;
-	size_t read_sz	    = 0;
-
-	/* Read the raw audio data */
-	errno		    = 0;
-	read_sz = fread(in_buffer, sizeof(int32_t), in_buffer_sz, dec->fh);
-	if (read_sz < in_buffer_sz) {
-		/* Short read, check for read errors */
-		if (errno != 0) {
-			return -errno;
-		} else {
-			dec->state |= SSTVENC_SUNAU_STATE_EOF;
-		}
+	uint8_t* map = mmap(NULL, hdr[1] + data_sz, PROT_READ, MAP_PRIVATE,
+			    fd, 0);
+	if (map == MAP_FAILED) {
+		res = -errno;
+		goto out;
 	}
 
-	/* Read is successful, write sample count, convert samples to
-	 * double-precision float */
-	*n_samples = read_sz;
-	while (read_sz) {
-		int32_t host_endian = be32toh(*in_buffer);
+	/* We read it front to back, and may well do so more than once */
+	madvise(map, hdr[1] + data_sz, MADV_SEQUENTIAL);
 
-		*samples = -(double)(host_endian) / (double)INT32_MIN;
-		samples++;
-		in_buffer++;
-		read_sz--;
-	}
+	/* All ready, the mapping outlives the file descriptor */
+	dec->fh		= NULL;
+	dec->buffer	= map + hdr[1];
+	dec->buffer_sz	= data_sz;
+	dec->buffer_len = 0;
+	dec->fd		= -1;
+	dec->written_sz = hdr[1];
+	dec->data_sz	= hdr[2];
+	dec->state	= SSTVENC_SUNAU_STATE_MMAP;
 
-	return 0;
+out:
+	close(fd);
+	return res;
 }
 
-static int sstvenc_sunau_read_f32(struct sstvenc_sunau* const dec,
-				  size_t* const n_samples, double* samples) {
-	/* Use the end of the output buffer as scratch space. */
-	uint32_t* in_buffer = (uint32_t*)(&(samples[*n_samples]))
-			      - (sizeof(uint32_t) * (*n_samples));
-	size_t in_buffer_sz = *n_samples;
-	size_t read_sz	    = 0;
-
-	/* Read the raw audio data */
-	errno		    = 0;
-	read_sz = fread(in_buffer, sizeof(float), in_buffer_sz, dec->fh);
-	if (read_sz < in_buffer_sz) {
-		/* Short read, check for read errors */
-		if (errno != 0) {
-			return -errno;
-		} else {
-			dec->state |= SSTVENC_SUNAU_STATE_EOF;
-		}
+const void* sstvenc_sunau_dec_get_data(const struct sstvenc_sunau* const dec,
+				       size_t* const n_samples) {
+	if (!(dec->state & SSTVENC_SUNAU_STATE_MMAP) || !dec->buffer) {
+		return NULL;
 	}
 
-	/* Read is successful, write sample count, convert samples to native
-	 * endianness */
-	*n_samples = read_sz;
-	while (read_sz) {
-		*samples = fbe32toh(*in_buffer);
-		samples++;
-		in_buffer++;
-		read_sz--;
+	*n_samples = dec->buffer_sz / sstvenc_sunau_sample_sz(dec);
+	return dec->buffer;
+}
+
+int sstvenc_sunau_dec_reset(struct sstvenc_sunau* const dec) {
+	if (dec->state & SSTVENC_SUNAU_STATE_MMAP) {
+		/* Rewind to the start of the mapped data */
+		dec->buffer_len = 0;
+	} else if (fseek(dec->fh, dec->written_sz, SEEK_SET) < 0) {
+		/* Seek failed */
+		return -errno;
 	}
 
+	/* Clear the EOF bit, as we should be back at the start */
+	dec->state &= ~SSTVENC_SUNAU_STATE_EOF;
 	return 0;
 }
 
-static int sstvenc_sunau_read_f64(struct sstvenc_sunau* const dec,
-				  size_t* const n_samples, double* samples) {
-	/* Use the output buffer as scratch space */
-	uint64_t* in_buffer    = (uint64_t*)samples;
-	size_t	  in_buffer_sz = *n_samples;
-	size_t	  read_sz      = 0;
-
-	/* Read the raw audio data */
-	errno		       = 0;
-	read_sz = fread(in_buffer, sizeof(double), in_buffer_sz, dec->fh);
-	if (read_sz < in_buffer_sz) {
-		/* Short read, check for read errors */
-		if (errno != 0) {
-			return -errno;
-		} else {
-			dec->state |= SSTVENC_SUNAU_STATE_EOF;
-		}
+/*!
+ * Read raw samples from a memory-mapped file.  Where the file data is
+ * suitably aligned, it is handed to the converter straight from the
+ * mapping, otherwise it is copied to the end of the output buffer first.
+ *
+ * @param[inout]	dec		SunAU decoder context
+ * @param[in]		n_samples	Number of samples wanted
+ * @param[out]		samples		Output buffer
+ * @param[out]		in_buffer	Pointer to the raw samples
+ *
+ * @returns		Number of samples available at @a in_buffer
+ */
+static size_t sstvenc_sunau_dec_read_mmap(struct sstvenc_sunau* const dec,
+					  size_t n_samples, double* samples,
+					  const void** const in_buffer) {
+	const size_t   sample_sz = sstvenc_sunau_sample_sz(dec);
+	const size_t   avail_sz	 = dec->buffer_sz - dec->buffer_len;
+	const uint8_t* in	 = dec->buffer + dec->buffer_len;
+
+	if ((n_samples * sample_sz) >= avail_sz) {
+		/* This will take us to the end of the data */
+		n_samples = avail_sz / sample_sz;
+		dec->state |= SSTVENC_SUNAU_STATE_EOF;
 	}
 
-	/* Read is successful, write sample count, convert samples to native
-	 * endianness */
-	*n_samples = read_sz;
-	while (read_sz) {
-		*samples = dbe64toh(*in_buffer);
-		samples++;
-		in_buffer++;
-		read_sz--;
+	if (((uintptr_t)in % sample_sz) != 0) {
+		uint8_t* copy = (uint8_t*)(&(samples[n_samples]))
+				- (sample_sz * n_samples);
+		memcpy(copy, in, sample_sz * n_samples);
+		in = copy;
 	}
 
-	return 0;
+	dec->buffer_len += sample_sz * n_samples;
+	*in_buffer	= in;
+	return n_samples;
 }
 
 int sstvenc_sunau_dec_read(struct sstvenc_sunau* const dec,
 			   size_t* const n_samples, double* samples) {
+	const size_t sample_sz = sstvenc_sunau_sample_sz(dec);
+	size_t	     read_sz   = 0;
+	const void*  in_buffer = NULL;
+
+	if (dec->state & SSTVENC_SUNAU_STATE_MMAP) {
+		read_sz = sstvenc_sunau_dec_read_mmap(dec, *n_samples,
+						      samples, &in_buffer);
+	} else {
+		/*
+		 * Read the raw audio data into the end of the output buffer,
+		 * then widen it in place.
+		 */
+		void* end_buffer = (uint8_t*)(&(samples[*n_samples]))
+				   - (sample_sz * (*n_samples));
+
+		errno	= 0;
+		read_sz = fread(end_buffer, sample_sz, *n_samples, dec->fh);
+		if (read_sz < *n_samples) {
+			/* Short read, check for read errors */
+			if (errno != 0) {
+				return -errno;
+			} else {
+				dec->state |= SSTVENC_SUNAU_STATE_EOF;
+			}
+		}
+
+		in_buffer = end_buffer;
+	}
+
+	/* Read is successful, write sample count, convert samples to
+	 * double-precision float */
+	*n_samples = read_sz;
 	switch (dec->encoding) {
 	case SSTVENC_SUNAU_FMT_S8:
-		return sstvenc_sunau_read_s8(dec, n_samples, samples);
+		sstvenc_sampfmt_s8_to_f64(samples, in_buffer, read_sz);
+		break;
 	case SSTVENC_SUNAU_FMT_S16:
-		return sstvenc_sunau_read_s16(dec, n_samples, samples);
+		sstvenc_sampfmt_s16_to_f64(samples, in_buffer, read_sz,
+					   SSTVENC_SAMPFMT_ENDIAN_BIG);
+		break;
 	case SSTVENC_SUNAU_FMT_S32:
-		return sstvenc_sunau_read_s32(dec, n_samples, samples);
+		sstvenc_sampfmt_s32_to_f64(samples, in_buffer, read_sz,
+					   SSTVENC_SAMPFMT_ENDIAN_BIG);
+		break;
 	case SSTVENC_SUNAU_FMT_F32:
-		return sstvenc_sunau_read_f32(dec, n_samples, samples);
+		sstvenc_sampfmt_f32be_to_f64(samples, in_buffer, read_sz);
+		break;
 	case SSTVENC_SUNAU_FMT_F64:
-		return sstvenc_sunau_read_f64(dec, n_samples, samples);
+		sstvenc_sampfmt_f64be_to_f64(samples, in_buffer, read_sz);
+		break;
 	default:
 		assert(0);
 		return -EINVAL;
 	}
+
+	return 0;
 }
 
 int sstvenc_sunau_dec_close(struct sstvenc_sunau* const dec) {
+	if (dec->state & SSTVENC_SUNAU_STATE_MMAP) {
+		uint8_t* map = dec->buffer - dec->written_sz;
+		int	 res = 0;
+
+		if (dec->buffer
+		    && (munmap(map, dec->written_sz + dec->buffer_sz) < 0)) {
+			res = -errno;
+		}
+
+		dec->buffer	= NULL;
+		dec->buffer_sz	= 0;
+		dec->buffer_len = 0;
+		return res;
+	}
+
 	int res = fclose(dec->fh);
 	dec->fh = NULL;
 
@@ -732,7 +979,12 @@ static int
 sstvenc_sunau_src_init(struct sstvenc_sequencer_ausrc* const ausrc) {
 	struct sstvenc_sunau_src* const src
 	    = (struct sstvenc_sunau_src*)(ausrc->context);
-	int res = sstvenc_sunau_dec_init(&(src->dec), src->path);
+	int res = sstvenc_sunau_dec_init_mmap(&(src->dec), src->path);
+	if (res < 0) {
+		/* Can't be mapped, read it through stdio */
+		res = sstvenc_sunau_dec_init(&(src->dec), src->path);
+	}
+
 	if (res == 0) {
 		src->buffer_ptr = 0;
 		src->buffer_len = 0;
@@ -770,7 +1022,7 @@ static int sstvenc_sunau_src_next(struct sstvenc_sequencer_ausrc* const ausrc,
 					*sample = output / (double)count;
 				}
 
-				if (src->dec.fh) {
+				if (src->dec.fh || src->dec.buffer) {
 					return sstvenc_sunau_dec_close(
 					    &(src->dec));
 				} else {
@@ -820,7 +1072,13 @@ static int
 sstvenc_sunau_src_close(struct sstvenc_sequencer_ausrc* const ausrc) {
 	struct sstvenc_sunau_src* const src
 	    = (struct sstvenc_sunau_src*)(ausrc->context);
-	return sstvenc_sunau_dec_close(&(src->dec));
+
+	if (src->dec.fh || src->dec.buffer) {
+		return sstvenc_sunau_dec_close(&(src->dec));
+	} else {
+		/* Already closed at the end of the file */
+		return 0;
+	}
 }
 
 /*! @} */
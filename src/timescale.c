@@ -64,4 +64,22 @@ double sstvenc_ts_samples_to_unit(uint32_t samples, uint32_t sample_rate,
 	}
 }
 
+void sstvenc_ts_clock_init(struct sstvenc_ts_clock* const clk,
+			   uint32_t			    sample_rate) {
+	/* Start half a sample in so boundaries round to the nearest sample */
+	clk->sample_rate = sample_rate;
+	clk->frac = sstvenc_ts_unit_scale(SSTVENC_TS_UNIT_NANOSECONDS) / 2;
+}
+
+uint32_t sstvenc_ts_clock_advance(struct sstvenc_ts_clock* const clk,
+				  uint32_t duration_ns) {
+	const uint64_t scale
+	    = sstvenc_ts_unit_scale(SSTVENC_TS_UNIT_NANOSECONDS);
+	const uint64_t pos
+	    = clk->frac + (((uint64_t)duration_ns) * clk->sample_rate);
+
+	clk->frac = pos % scale;
+	return sstvenc_ts_clamp_samples(pos / scale);
+}
+
 /*! @} */
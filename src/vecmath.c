@@ -0,0 +1,306 @@
+/*!
+ * @addtogroup vecmath
+ * @{
+ */
+
+/*
+ * © Stuart Longland VK4MSL
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <libsstvenc/cpu.h>
+#include <libsstvenc/vecmath.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/*!
+ * Minimax coefficients for sin(x) ≈ x·P(x²) over [-π/2, π/2], lowest order
+ * first.
+ */
+#define SSTVENC_VEC_SIN_C0 (9.99999999999625e-01)
+#define SSTVENC_VEC_SIN_C1 (-1.666666666609835e-01)
+#define SSTVENC_VEC_SIN_C2 (8.333333308419214e-03)
+#define SSTVENC_VEC_SIN_C3 (-1.9841265024473736e-04)
+#define SSTVENC_VEC_SIN_C4 (2.755684089468543e-06)
+#define SSTVENC_VEC_SIN_C5 (-2.5026636793612577e-08)
+#define SSTVENC_VEC_SIN_C6 (1.5365940896938225e-10)
+
+/*!
+ * Scalar polynomial sine, x in [-π/2, π/2].
+ */
+static inline double sstvenc_vec_sinpoly(double x) {
+	const double x2 = x * x;
+	double	     p	= SSTVENC_VEC_SIN_C6;
+	p		= (p * x2) + SSTVENC_VEC_SIN_C5;
+	p		= (p * x2) + SSTVENC_VEC_SIN_C4;
+	p		= (p * x2) + SSTVENC_VEC_SIN_C3;
+	p		= (p * x2) + SSTVENC_VEC_SIN_C2;
+	p		= (p * x2) + SSTVENC_VEC_SIN_C1;
+	p		= (p * x2) + SSTVENC_VEC_SIN_C0;
+	return x * p;
+}
+
+static void sstvenc_vec_sin_scalar(double* y, const double* x,
+				   double amplitude, size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		y[i] = amplitude * sstvenc_vec_sinpoly(x[i]);
+	}
+}
+
+static void sstvenc_vec_sin_env_scalar(double* y, const double* x,
+				       const double* envelope, size_t sz) {
+	for (size_t i = 0; i < sz; i++) {
+		y[i] = envelope[i] * sstvenc_vec_sinpoly(x[i]);
+	}
+}
+
+/*!
+ * Portable scalar kernels.
+ */
+static const struct sstvenc_vec_ops sstvenc_vec_ops_scalar = {
+    .sin     = sstvenc_vec_sin_scalar,
+    .sin_env = sstvenc_vec_sin_env_scalar,
+};
+
+#if defined(__x86_64__)
+/*!
+ * SSE2 polynomial sine, two values at a time.
+ */
+static inline __m128d sstvenc_vec_sinpoly_sse2(__m128d x) {
+	const __m128d x2 = _mm_mul_pd(x, x);
+	__m128d	      p	 = _mm_set1_pd(SSTVENC_VEC_SIN_C6);
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SSTVENC_VEC_SIN_C5));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SSTVENC_VEC_SIN_C4));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SSTVENC_VEC_SIN_C3));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SSTVENC_VEC_SIN_C2));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SSTVENC_VEC_SIN_C1));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SSTVENC_VEC_SIN_C0));
+	return _mm_mul_pd(x, p);
+}
+
+static void sstvenc_vec_sin_sse2(double* y, const double* x,
+				 double amplitude, size_t sz) {
+	const __m128d a = _mm_set1_pd(amplitude);
+	size_t	      i = 0;
+
+	for (; (i + 2) <= sz; i += 2) {
+		const __m128d v
+		    = sstvenc_vec_sinpoly_sse2(_mm_loadu_pd(x + i));
+		_mm_storeu_pd(y + i, _mm_mul_pd(a, v));
+	}
+
+	sstvenc_vec_sin_scalar(y + i, x + i, amplitude, sz - i);
+}
+
+static void sstvenc_vec_sin_env_sse2(double* y, const double* x,
+				     const double* envelope, size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 2) <= sz; i += 2) {
+		const __m128d e = _mm_loadu_pd(envelope + i);
+		const __m128d v
+		    = sstvenc_vec_sinpoly_sse2(_mm_loadu_pd(x + i));
+		_mm_storeu_pd(y + i, _mm_mul_pd(e, v));
+	}
+
+	sstvenc_vec_sin_env_scalar(y + i, x + i, envelope + i, sz - i);
+}
+
+/*!
+ * SSE2 kernels.
+ */
+static const struct sstvenc_vec_ops sstvenc_vec_ops_sse2 = {
+    .sin     = sstvenc_vec_sin_sse2,
+    .sin_env = sstvenc_vec_sin_env_sse2,
+};
+
+/*!
+ * AVX2 polynomial sine, four values at a time.  Multiply and add are kept
+ * separate (no FMA) so results match the scalar and SSE2 kernels.
+ *
+ * The AVX2 kernels hand the last few values to the SSE2 kernels.  They clear
+ * the upper halves of the YMM registers first: the compiler omits
+ * `vzeroupper` when the call becomes a tail call, and legacy SSE code run
+ * with dirty upper state is penalised on every call.
+ */
+__attribute__((target("avx2"))) static inline __m256d
+sstvenc_vec_sinpoly_avx2(__m256d x) {
+	const __m256d x2 = _mm256_mul_pd(x, x);
+	__m256d	      p	 = _mm256_set1_pd(SSTVENC_VEC_SIN_C6);
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+			  _mm256_set1_pd(SSTVENC_VEC_SIN_C5));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+			  _mm256_set1_pd(SSTVENC_VEC_SIN_C4));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+			  _mm256_set1_pd(SSTVENC_VEC_SIN_C3));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+			  _mm256_set1_pd(SSTVENC_VEC_SIN_C2));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+			  _mm256_set1_pd(SSTVENC_VEC_SIN_C1));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+			  _mm256_set1_pd(SSTVENC_VEC_SIN_C0));
+	return _mm256_mul_pd(x, p);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_vec_sin_avx2(double* y, const double* x, double amplitude,
+		     size_t sz) {
+	const __m256d a = _mm256_set1_pd(amplitude);
+	size_t	      i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		const __m256d v
+		    = sstvenc_vec_sinpoly_avx2(_mm256_loadu_pd(x + i));
+		_mm256_storeu_pd(y + i, _mm256_mul_pd(a, v));
+	}
+
+	_mm256_zeroupper();
+	sstvenc_vec_sin_sse2(y + i, x + i, amplitude, sz - i);
+}
+
+__attribute__((target("avx2"))) static void
+sstvenc_vec_sin_env_avx2(double* y, const double* x, const double* envelope,
+			 size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 4) <= sz; i += 4) {
+		const __m256d e = _mm256_loadu_pd(envelope + i);
+		const __m256d v
+		    = sstvenc_vec_sinpoly_avx2(_mm256_loadu_pd(x + i));
+		_mm256_storeu_pd(y + i, _mm256_mul_pd(e, v));
+	}
+
+	_mm256_zeroupper();
+	sstvenc_vec_sin_env_sse2(y + i, x + i, envelope + i, sz - i);
+}
+
+/*!
+ * AVX2 kernels.
+ */
+static const struct sstvenc_vec_ops sstvenc_vec_ops_avx2 = {
+    .sin     = sstvenc_vec_sin_avx2,
+    .sin_env = sstvenc_vec_sin_env_avx2,
+};
+#endif
+
+#if defined(__aarch64__)
+/*!
+ * NEON polynomial sine, two values at a time.
+ */
+static inline float64x2_t sstvenc_vec_sinpoly_neon(float64x2_t x) {
+	const float64x2_t x2 = vmulq_f64(x, x);
+	float64x2_t	  p  = vdupq_n_f64(SSTVENC_VEC_SIN_C6);
+	p = vaddq_f64(vmulq_f64(p, x2), vdupq_n_f64(SSTVENC_VEC_SIN_C5));
+	p = vaddq_f64(vmulq_f64(p, x2), vdupq_n_f64(SSTVENC_VEC_SIN_C4));
+	p = vaddq_f64(vmulq_f64(p, x2), vdupq_n_f64(SSTVENC_VEC_SIN_C3));
+	p = vaddq_f64(vmulq_f64(p, x2), vdupq_n_f64(SSTVENC_VEC_SIN_C2));
+	p = vaddq_f64(vmulq_f64(p, x2), vdupq_n_f64(SSTVENC_VEC_SIN_C1));
+	p = vaddq_f64(vmulq_f64(p, x2), vdupq_n_f64(SSTVENC_VEC_SIN_C0));
+	return vmulq_f64(x, p);
+}
+
+static void sstvenc_vec_sin_neon(double* y, const double* x,
+				 double amplitude, size_t sz) {
+	const float64x2_t a = vdupq_n_f64(amplitude);
+	size_t		  i = 0;
+
+	for (; (i + 2) <= sz; i += 2) {
+		const float64x2_t v
+		    = sstvenc_vec_sinpoly_neon(vld1q_f64(x + i));
+		vst1q_f64(y + i, vmulq_f64(a, v));
+	}
+
+	sstvenc_vec_sin_scalar(y + i, x + i, amplitude, sz - i);
+}
+
+static void sstvenc_vec_sin_env_neon(double* y, const double* x,
+				     const double* envelope, size_t sz) {
+	size_t i = 0;
+
+	for (; (i + 2) <= sz; i += 2) {
+		const float64x2_t e = vld1q_f64(envelope + i);
+		const float64x2_t v
+		    = sstvenc_vec_sinpoly_neon(vld1q_f64(x + i));
+		vst1q_f64(y + i, vmulq_f64(e, v));
+	}
+
+	sstvenc_vec_sin_env_scalar(y + i, x + i, envelope + i, sz - i);
+}
+
+/*!
+ * NEON kernels.
+ */
+static const struct sstvenc_vec_ops sstvenc_vec_ops_neon = {
+    .sin     = sstvenc_vec_sin_neon,
+    .sin_env = sstvenc_vec_sin_env_neon,
+};
+#endif
+
+/*!
+ * The kernels chosen for the features the host CPU supports.
+ */
+static const struct sstvenc_vec_ops* sstvenc_vec_ops_detected = NULL;
+
+/*!
+ * Guard for one-time selection of @ref sstvenc_vec_ops_detected.
+ */
+static pthread_once_t		     sstvenc_vec_ops_once
+    = PTHREAD_ONCE_INIT;
+
+/*!
+ * Return the best kernels for the given CPU features.
+ */
+static const struct sstvenc_vec_ops*
+sstvenc_vec_ops_select(uint32_t features) {
+	const struct sstvenc_vec_ops* ops = &sstvenc_vec_ops_scalar;
+#if defined(__x86_64__)
+	if (features & SSTVENC_CPU_FEAT_AVX2) {
+		ops = &sstvenc_vec_ops_avx2;
+	} else if (features & SSTVENC_CPU_FEAT_SSE2) {
+		ops = &sstvenc_vec_ops_sse2;
+	}
+#elif defined(__aarch64__)
+	if (features & SSTVENC_CPU_FEAT_NEON) {
+		ops = &sstvenc_vec_ops_neon;
+	}
+#endif
+
+	return ops;
+}
+
+/*!
+ * Choose the kernels for the host CPU.
+ */
+static void sstvenc_vec_ops_init(void) {
+	sstvenc_vec_ops_detected
+	    = sstvenc_vec_ops_select(sstvenc_cpu_detect());
+}
+
+const struct sstvenc_vec_ops* sstvenc_vec_get_ops(void) {
+	const uint32_t features = sstvenc_cpu_get_features();
+
+	pthread_once(&sstvenc_vec_ops_once, sstvenc_vec_ops_init);
+	if (features == sstvenc_cpu_detect()) {
+		return sstvenc_vec_ops_detected;
+	}
+
+	return sstvenc_vec_ops_select(features);
+}
+
+void sstvenc_vec_sin(double* y, const double* x, double amplitude,
+		     size_t sz) {
+	sstvenc_vec_get_ops()->sin(y, x, amplitude, sz);
+}
+
+void sstvenc_vec_sin_env(double* y, const double* x, const double* envelope,
+			 size_t sz) {
+	sstvenc_vec_get_ops()->sin_env(y, x, envelope, sz);
+}
+
+/*! @} */